@@ -0,0 +1,138 @@
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "loop.hpp"
+
+/*
+参考 libuv 的 benchmark-async-pummel.c。多个线程向同 1 个 loop 投递任务：
+
+1. post：Loop::post，无锁 MPSC 队列，一批任务只调用 1 次 uv_async_send、唤醒 1 次。输出 async send 的次数
+   （LoopMetrics::signals）和 async 回调的次数（LoopMetrics::asyncs）。
+2. raw：mutex + std::deque，每个任务调用 1 次 uv_async_send。
+*/
+
+namespace {
+
+// 每个生产者投递的任务数
+constexpr int TASKS = 250000;
+
+struct Raw {
+    uv_async_t async;
+    std::mutex mutex;
+    std::deque<std::function<void()>> queue;
+    std::deque<std::function<void()>> running;
+    int wakeups{0};
+};
+
+void pummel(int producers, const std::function<void(int &)> &produce, const std::function<void()> &run, int &count) {
+    std::vector<std::thread> threads;
+    auto begin = uv_hrtime();
+
+    for (int i = 0; i < producers; ++i) {
+        threads.emplace_back([&produce, &count]() {
+            for (int j = 0; j < TASKS; ++j) {
+                produce(count);
+            }
+        });
+    }
+
+    run();
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    auto secs = bench::seconds(begin, uv_hrtime());
+    std::cout << "  " << producers << " producers: " << count << " tasks in " << secs << "s, "
+              << static_cast<std::uint64_t>(count / secs) << " tasks/s";
+}
+
+int post(int producers) {
+    auto loop = uvcls::Loop::create();
+    int count = 0;
+    const int total = producers * TASKS;
+
+    // 最后 1 个任务让 run 返回
+    loop->keepAlive(true);
+
+    auto produce = [&loop, total](int &cnt) {
+        loop->post([&loop, &cnt, total]() {
+            if (++cnt == total) {
+                loop->keepAlive(false);
+            }
+        });
+    };
+
+    pummel(producers, produce, [&loop]() { loop->run(); }, count);
+
+    auto metrics = loop->metrics();
+    std::cout << ", " << metrics.signals << " async sends, " << metrics.asyncs << " wakeups" << std::endl;
+
+    return count == total ? 0 : 1;
+}
+
+int raw(int producers) {
+    auto loop = uvcls::Loop::create();
+    Raw ctx{};
+    int count = 0;
+    const int total = producers * TASKS;
+
+    ctx.async.data = &ctx;
+    uv_async_init(loop->raw(), &ctx.async, [](uv_async_t *handle) {
+        auto &ref = *static_cast<Raw *>(handle->data);
+        ref.wakeups++;
+
+        {
+            std::lock_guard<std::mutex> lock{ref.mutex};
+            ref.running.swap(ref.queue);
+        }
+
+        for (auto &task : ref.running) {
+            task();
+        }
+
+        ref.running.clear();
+    });
+
+    auto produce = [&ctx, total](int &cnt) {
+        {
+            std::lock_guard<std::mutex> lock{ctx.mutex};
+            ctx.queue.emplace_back([&cnt, &ctx, total]() {
+                if (++cnt == total) {
+                    uv_close(reinterpret_cast<uv_handle_t *>(&ctx.async), nullptr);
+                }
+            });
+        }
+
+        uv_async_send(&ctx.async);
+    };
+
+    pummel(producers, produce, [&loop]() { loop->run(); }, count);
+    std::cout << ", " << total << " async sends, " << ctx.wakeups << " wakeups" << std::endl;
+
+    return count == total ? 0 : 1;
+}
+
+}  // namespace
+
+BENCHMARK(async_pummel) {
+    int failed = 0;
+
+    std::cout << "async_pummel (Loop::post)" << std::endl;
+    for (auto producers : {1, 2, 4}) {
+        failed += post(producers);
+    }
+
+    std::cout << "async_pummel (mutex + uv_async_send per task)" << std::endl;
+    for (auto producers : {1, 2, 4}) {
+        failed += raw(producers);
+    }
+
+    return failed;
+}
@@ -0,0 +1,43 @@
+#ifndef UVCLS_BENCH_H
+#define UVCLS_BENCH_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <uv.h>
+
+/*
+基准测试注册。每个 benchmark 文件用 BENCHMARK(name) 定义 1 个函数，ccbench 按名字运行，
+不带参数时运行全部。写法参考 libuv 的 test/benchmark-*.c。
+*/
+
+namespace bench {
+
+using Func = std::function<int()>;
+
+inline std::map<std::string, Func> &registry() {
+    static std::map<std::string, Func> benchmarks;
+    return benchmarks;
+}
+
+struct Registrar {
+    Registrar(const char *name, Func func) {
+        registry().emplace(name, std::move(func));
+    }
+};
+
+// 秒数，用于计算每秒的次数
+inline double seconds(std::uint64_t begin, std::uint64_t end) {
+    return static_cast<double>(end - begin) / 1e9;
+}
+
+}  // namespace bench
+
+#define BENCHMARK(name)                                                  \
+    static int bench_##name();                                           \
+    static bench::Registrar bench_registrar_##name{#name, &bench_##name}; \
+    static int bench_##name()
+
+#endif
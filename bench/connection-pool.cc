@@ -0,0 +1,95 @@
+#include <iostream>
+#include <memory>
+
+#include "bench.h"
+#include "tcp.hpp"
+#include "upstream.hpp"
+
+/*
+短请求的延迟。客户端依次发送 REQUESTS 个 1 字节的请求，同 1 个 loop 中的 echo server 回复 1 字节：
+
+1. connect：每个请求建立 1 个新连接，收到回复后关闭。
+2. pool：从 ConnectionPool 取连接，收到回复后归还，只有第 1 个请求需要握手。
+*/
+
+namespace {
+
+constexpr int REQUESTS = 20000;
+
+int run(bool pooled) {
+    auto loop = uvcls::Loop::create();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto pool = std::make_shared<uvcls::ConnectionPool>(loop, uvcls::PoolPolicy{});
+    int done = 0;
+
+    server->on<uvcls::ListenEvent>([](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::DataEvent>([](auto &event, auto &sock) { sock.write(std::move(event.data), event.length); });
+        socket->template on<uvcls::EndEvent>([](const auto &, auto &sock) { sock.close(); });
+        socket->template on<uvcls::ErrorEvent>([](const auto &, auto &sock) { sock.close(); });
+        handle.accept(*socket);
+        socket->read();
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen(1024);
+    uvcls::SocketAddress addr{"127.0.0.1", server->sock().port};
+
+    std::function<void()> next;
+
+    // 发送 1 个请求，收到回复后开始下 1 个
+    auto request = [&](std::shared_ptr<uvcls::TCPHandle> socket) {
+        socket->once<uvcls::DataEvent>([&, socket](const auto &, auto &sock) {
+            ++done;
+
+            if (pooled) {
+                pool->checkin(socket);
+            } else {
+                // 用 RST 关闭，不留下 TIME_WAIT，否则会用完本地端口
+                sock.closeReset();
+            }
+
+            next();
+        });
+        socket->write(const_cast<char *>("x"), 1);
+        socket->read();
+    };
+
+    next = [&]() {
+        if (done == REQUESTS) {
+            pool->close();
+            server->close();
+        } else if (pooled) {
+            pool->checkout(addr, [&](auto socket, int status) {
+                if (!status) {
+                    request(std::move(socket));
+                }
+            });
+        } else {
+            auto socket = loop->resource<uvcls::TCPHandle>();
+            socket->once<uvcls::ConnectEvent>([&, socket](const auto &, auto &) { request(socket); });
+            socket->connect(addr);
+        }
+    };
+
+    auto begin = uv_hrtime();
+    next();
+    loop->run();
+    auto end = uv_hrtime();
+
+    if (done != REQUESTS) {
+        return 1;
+    }
+
+    std::cout << "  " << (pooled ? "pool" : "connect") << ": " << static_cast<std::uint64_t>(done / bench::seconds(begin, end))
+              << " req/s, " << (end - begin) / 1000 / REQUESTS << " us per request" << std::endl;
+
+    return 0;
+}
+
+}  // namespace
+
+BENCHMARK(connection_pool) {
+    std::cout << "connection_pool (" << REQUESTS << " sequential requests)" << std::endl;
+    return run(false) + run(true);
+}
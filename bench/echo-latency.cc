@@ -0,0 +1,152 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "tcp.hpp"
+#include "timer.hpp"
+
+/*
+echo 服务器的延迟。客户端线程用阻塞 socket 一问一答，每 200 us 1 次，server loop 上每 10 ms 有 5 ms 的后台计算：
+
+1. inline：后台计算直接在定时器回调中执行完，期间所有连接都要等待。
+2. spawn：后台计算通过 Loop::spawn 分段执行，每轮最多 1 ms（Scheduler 的默认时间片）。
+3. default / spin：没有后台计算，分别用 DEFAULT 和 SPIN 模式运行 server loop，比较 loop 空闲时被唤醒的延迟。
+
+server 的连接打开接收时间戳，同时输出内核收到数据到 DataEvent 的延迟，它和往返延迟的差距就是网络部分。
+*/
+
+namespace {
+
+constexpr int PINGS = 2000;
+constexpr int PACE = 200;
+constexpr std::uint64_t WORK = 5000000;
+constexpr std::uint64_t UNIT = 20000;
+
+// 忙等 ns 纳秒，模拟 CPU 密集的计算
+void busy(std::uint64_t ns) {
+    for (auto end = uv_hrtime() + ns; uv_hrtime() < end;) {
+    }
+}
+
+std::vector<std::uint64_t> ping(unsigned int port) {
+    std::vector<std::uint64_t> samples;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<std::uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    auto fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) {
+        char byte = 'x';
+
+        for (int i = 0; i < PINGS; ++i) {
+            auto begin = uv_hrtime();
+
+            if (::send(fd, &byte, 1, 0) != 1 || ::recv(fd, &byte, 1, 0) != 1) {
+                break;
+            }
+
+            samples.push_back(uv_hrtime() - begin);
+            // 均匀地采样，后台计算期间和空闲期间的请求都会覆盖到
+            std::this_thread::sleep_for(std::chrono::microseconds{PACE});
+        }
+    }
+
+    ::close(fd);
+    return samples;
+}
+
+// 后台计算的方式，NONE 时没有后台计算
+enum class Work { NONE, INLINE, SPAWN };
+
+int run(Work work, uvcls::UVRunMode mode) {
+    auto loop = uvcls::Loop::create();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto ticker = loop->resource<uvcls::TimerHandle>();
+    auto latency = std::make_shared<uvcls::LatencyHistogram>();
+
+    server->on<uvcls::ListenEvent>([latency](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::DataEvent>([](auto &event, auto &sock) {
+            sock.write(std::move(event.data), static_cast<unsigned int>(event.length));
+        });
+        socket->template on<uvcls::EndEvent>([](const auto &, auto &sock) { sock.close(); });
+        handle.accept(*socket);
+        socket->noDelay(true);
+        socket->timestamping(true, latency);
+        socket->read();
+    });
+
+    ticker->on<uvcls::TimerEvent>([work](const auto &, auto &hndl) {
+        if (work == Work::NONE) {
+            return;
+        } else if (work == Work::INLINE) {
+            busy(WORK);
+            return;
+        }
+
+        hndl.loop().spawn([done = std::uint64_t{0}](const uvcls::TimeSlice &slice) mutable {
+            while (done < WORK && !slice.expired()) {
+                busy(UNIT);
+                done += UNIT;
+            }
+
+            return done < WORK;
+        }, uvcls::Priority::BACKGROUND);
+    });
+
+    server->timestamping(true);
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    ticker->start(uvcls::TimerHandle::Time{10}, uvcls::TimerHandle::Time{10});
+
+    std::vector<std::uint64_t> samples;
+    std::thread client{[&samples, &loop, &server, &ticker, port = server->sock().port]() {
+        samples = ping(port);
+        loop->post([&server, &ticker]() {
+            server->close();
+            ticker->close();
+        });
+    }};
+
+    if (mode == uvcls::UVRunMode::SPIN) {
+        loop->run<uvcls::UVRunMode::SPIN>();
+    } else {
+        loop->run();
+    }
+
+    client.join();
+
+    if (samples.empty()) {
+        return 1;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double q) { return samples[static_cast<std::size_t>(q * (samples.size() - 1))] / 1000; };
+    auto name = work == Work::INLINE ? "inline" : work == Work::SPAWN ? "spawn" : mode == uvcls::UVRunMode::SPIN ? "spin" : "default";
+    std::cout << "  " << name << ": " << samples.size() << " pings, p50 " << at(0.5)
+              << "us, p99 " << at(0.99) << "us, max " << samples.back() / 1000 << "us" << std::endl;
+    std::cout << "    kernel to handler: p50 " << latency->percentile(0.5).count() / 1000 << "us, p99 "
+              << latency->percentile(0.99).count() / 1000 << "us, max " << latency->max().count() / 1000 << "us" << std::endl;
+
+    return 0;
+}
+
+}  // namespace
+
+BENCHMARK(echo_latency) {
+    std::cout << "echo_latency (5 ms of background work every 10 ms)" << std::endl;
+    auto failed = run(Work::INLINE, uvcls::UVRunMode::DEFAULT) + run(Work::SPAWN, uvcls::UVRunMode::DEFAULT);
+    std::cout << "echo_latency (idle loop, DEFAULT vs SPIN wakeup)" << std::endl;
+    return failed + run(Work::NONE, uvcls::UVRunMode::DEFAULT) + run(Work::NONE, uvcls::UVRunMode::SPIN);
+}
@@ -0,0 +1,25 @@
+#include <iostream>
+
+#include "bench.h"
+
+int main(int argc, char **argv) {
+    auto &benchmarks = bench::registry();
+    int failed = 0;
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            if (auto it = benchmarks.find(argv[i]); it != benchmarks.end()) {
+                failed += it->second() != 0;
+            } else {
+                std::cerr << "unknown benchmark: " << argv[i] << std::endl;
+                failed++;
+            }
+        }
+    } else {
+        for (auto &&[name, func] : benchmarks) {
+            failed += func() != 0;
+        }
+    }
+
+    return failed;
+}
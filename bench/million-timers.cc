@@ -0,0 +1,91 @@
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "bench.h"
+#include "loop.hpp"
+
+/*
+参考 libuv 的 benchmark-million-timers.c。1M 个定时器，到期时间分布在 1 ~ 1000 ms：
+
+1. uv_timer_t：每个定时器 1 个最小堆节点。
+2. WheelTimer：Loop::wheel() 的时间轮，共用 1 个 uv_timer_t。
+
+另外测 1 次全部重新调度（每个连接收到数据时重置超时）的耗时。
+*/
+
+namespace {
+
+constexpr int TIMERS = 1000 * 1000;
+
+void report(const char *name, std::uint64_t begin, std::uint64_t armed, std::uint64_t rearmed, std::uint64_t end, int fired) {
+    std::cout << "  " << name << ": start " << bench::seconds(begin, armed) << "s, re-arm " << bench::seconds(armed, rearmed)
+              << "s, run " << bench::seconds(rearmed, end) << "s, " << fired << " fired" << std::endl;
+}
+
+int heap() {
+    auto loop = uvcls::Loop::create();
+    std::unique_ptr<uv_timer_t[]> timers{new uv_timer_t[TIMERS]};
+    int fired = 0;
+    int closed = 0;
+
+    auto callback = [](uv_timer_t *handle) {
+        ++*static_cast<int *>(handle->data);
+        uv_close(reinterpret_cast<uv_handle_t *>(handle), [](uv_handle_t *hndl) {
+            ++*static_cast<int *>(uv_loop_get_data(hndl->loop));
+        });
+    };
+
+    uv_loop_set_data(loop->raw(), &closed);
+    auto begin = uv_hrtime();
+
+    for (int i = 0; i < TIMERS; ++i) {
+        uv_timer_init(loop->raw(), &timers[i]);
+        timers[i].data = &fired;
+        uv_timer_start(&timers[i], callback, i % 1000 + 1, 0);
+    }
+
+    auto armed = uv_hrtime();
+
+    for (int i = 0; i < TIMERS; ++i) {
+        uv_timer_start(&timers[i], callback, (i + 500) % 1000 + 1, 0);
+    }
+
+    auto rearmed = uv_hrtime();
+    loop->run();
+    report("uv_timer_t", begin, armed, rearmed, uv_hrtime(), fired);
+
+    return fired == TIMERS && closed == TIMERS ? 0 : 1;
+}
+
+int wheel() {
+    auto loop = uvcls::Loop::create();
+    auto &wheel = loop->wheel();
+    std::vector<uvcls::WheelTimer> timers(TIMERS);
+    int fired = 0;
+    auto begin = uv_hrtime();
+
+    for (int i = 0; i < TIMERS; ++i) {
+        timers[i].on([&fired]() { ++fired; });
+        wheel.schedule(timers[i], i % 1000 + 1);
+    }
+
+    auto armed = uv_hrtime();
+
+    for (int i = 0; i < TIMERS; ++i) {
+        wheel.schedule(timers[i], (i + 500) % 1000 + 1);
+    }
+
+    auto rearmed = uv_hrtime();
+    loop->run();
+    report("WheelTimer", begin, armed, rearmed, uv_hrtime(), fired);
+
+    return fired == TIMERS ? 0 : 1;
+}
+
+}  // namespace
+
+BENCHMARK(million_timers) {
+    std::cout << "million_timers" << std::endl;
+    return heap() + wheel();
+}
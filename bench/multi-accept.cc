@@ -0,0 +1,116 @@
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "tcp.hpp"
+
+/*
+accept 的吞吐。客户端线程每次用阻塞 socket 连续建立 BURST 个连接再全部关闭，server 接受后立即关闭：
+
+1. listen：每个连接 1 个 ListenEvent，1 次可读事件中 libuv 反复回调直到 EAGAIN。
+2. batch：每次可读事件最多取 BATCH 个连接，只发布 1 个 AcceptedEvent，handle 是预先创建好的。
+*/
+
+namespace {
+
+constexpr int THREADS = 4;
+constexpr int BURST = 16;
+constexpr std::size_t BATCH = 64;
+constexpr std::uint64_t DURATION = 1000000000;
+
+void connector(unsigned int port, const std::atomic<bool> &stop) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<std::uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    // 用 RST 关闭，不留下 TIME_WAIT，否则两轮测试会用完本地端口
+    linger reset{1, 0};
+    int fds[BURST];
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        for (auto &fd : fds) {
+            fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+            ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+        }
+
+        for (auto fd : fds) {
+            ::close(fd);
+        }
+    }
+}
+
+int run(bool batch) {
+    auto loop = uvcls::Loop::create();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    std::uint64_t accepted = 0;
+    std::uint64_t events = 0;
+
+    if (batch) {
+        server->batch(BATCH);
+        server->on<uvcls::AcceptedEvent<uvcls::TCPHandle>>([&](const auto &event, auto &) {
+            for (auto &socket : event) {
+                socket->close();
+            }
+
+            accepted += event.size();
+            events++;
+        });
+    } else {
+        server->on<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+            auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+            handle.accept(*socket);
+            socket->close();
+            accepted++;
+            events++;
+        });
+    }
+
+    server->bind("127.0.0.1", 0);
+    server->listen(1024);
+
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> clients;
+
+    for (int i = 0; i < THREADS; ++i) {
+        clients.emplace_back(connector, server->sock().port, std::cref(stop));
+    }
+
+    std::thread timer{[&loop, &server, &stop]() {
+        std::this_thread::sleep_for(std::chrono::nanoseconds{DURATION});
+        stop = true;
+        loop->post([&server]() { server->close(); });
+    }};
+
+    auto begin = uv_hrtime();
+    loop->run();
+    auto end = uv_hrtime();
+
+    timer.join();
+
+    for (auto &client : clients) {
+        client.join();
+    }
+
+    if (!accepted) {
+        return 1;
+    }
+
+    std::cout << "  " << (batch ? "batch" : "listen") << ": " << static_cast<std::uint64_t>(accepted / bench::seconds(begin, end))
+              << " accepts/s, " << static_cast<double>(accepted) / static_cast<double>(events) << " per event" << std::endl;
+
+    return 0;
+}
+
+}  // namespace
+
+BENCHMARK(multi_accept) {
+    std::cout << "multi_accept (" << THREADS << " threads, " << BURST << " connections per burst)" << std::endl;
+    return run(false) + run(true);
+}
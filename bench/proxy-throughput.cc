@@ -0,0 +1,128 @@
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "proxy.hpp"
+#include "tcp.hpp"
+
+/*
+单向代理的吞吐。发送线程用阻塞 socket 连续写 TOTAL 字节后关闭，loop 把 front 上接受的连接转发给
+接收线程监听的 socket，接收线程读到 EOF 为止：
+
+1. copy：DataEvent → write，每个字节在用户空间复制 2 次。
+2. splice：socket → 内核 pipe → socket，数据不经过用户空间。
+*/
+
+namespace {
+
+constexpr std::size_t TOTAL = 1ull << 30;
+constexpr std::size_t CHUNK = 64 * 1024;
+
+sockaddr_in loopback(unsigned int port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<std::uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+void produce(unsigned int port) {
+    auto addr = loopback(port);
+    std::vector<char> buffer(CHUNK, 'x');
+    auto fd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) {
+        for (std::size_t sent = 0; sent < TOTAL;) {
+            auto n = ::write(fd, buffer.data(), std::min(CHUNK, TOTAL - sent));
+
+            if (n <= 0) {
+                break;
+            }
+
+            sent += static_cast<std::size_t>(n);
+        }
+    }
+
+    ::close(fd);
+}
+
+void consume(int listener, std::size_t &received) {
+    std::vector<char> buffer(CHUNK);
+    auto fd = ::accept(listener, nullptr, nullptr);
+
+    for (ssize_t n; (n = ::read(fd, buffer.data(), CHUNK)) > 0;) {
+        received += static_cast<std::size_t>(n);
+    }
+
+    ::close(fd);
+}
+
+int run(uvcls::PipeMode mode) {
+    auto loop = uvcls::Loop::create();
+    auto front = loop->resource<uvcls::TCPHandle>();
+    auto inner = loop->resource<uvcls::TCPHandle>();
+    auto outer = loop->resource<uvcls::TCPHandle>();
+    auto actual = mode;
+
+    auto sink = ::socket(AF_INET, SOCK_STREAM, 0);
+    auto addr = loopback(0);
+    socklen_t len = sizeof(addr);
+    ::bind(sink, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ::listen(sink, 1);
+    ::getsockname(sink, reinterpret_cast<sockaddr *>(&addr), &len);
+
+    front->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        handle.accept(*inner);
+        handle.close();
+
+        outer->once<uvcls::ConnectEvent>([&](const auto &, auto &) {
+            auto pipe = uvcls::pipe(inner, outer, mode);
+            actual = pipe->mode();
+            pipe->template once<uvcls::PipeEndEvent>([&](const auto &, auto &) {
+                inner->close();
+                outer->close();
+            });
+            pipe->template once<uvcls::ErrorEvent>([&](const auto &, auto &) {
+                inner->close();
+                outer->close();
+            });
+        });
+        outer->connect(*reinterpret_cast<sockaddr *>(&addr));
+    });
+
+    front->bind("127.0.0.1", 0);
+    front->listen();
+
+    std::size_t received = 0;
+    auto begin = uv_hrtime();
+    std::thread consumer{consume, sink, std::ref(received)};
+    std::thread producer{produce, front->sock().port};
+
+    loop->run();
+    producer.join();
+    consumer.join();
+    auto end = uv_hrtime();
+    ::close(sink);
+
+    if (received != TOTAL) {
+        return 1;
+    }
+
+    auto mb = static_cast<double>(TOTAL) / (1 << 20);
+    std::cout << "  " << (actual == uvcls::PipeMode::SPLICE ? "splice" : "copy") << ": "
+              << static_cast<std::uint64_t>(mb / bench::seconds(begin, end)) << " MB/s" << std::endl;
+
+    return 0;
+}
+
+}  // namespace
+
+BENCHMARK(proxy_throughput) {
+    std::cout << "proxy_throughput (" << (TOTAL >> 20) << " MB through loopback)" << std::endl;
+    return run(uvcls::PipeMode::COPY) + run(uvcls::PipeMode::SPLICE);
+}
@@ -2,16 +2,32 @@
     "target_defaults": {
         "include_dirs": ["deps/uv/include", "src/lib"],
         "sources": [
+            "src/lib/channel.hpp",
             "src/lib/config.h",
             "src/lib/emitter.hpp",
             "src/lib/loop.hpp",
+            "src/lib/numa.hpp",
+            "src/lib/poll.hpp",
+            "src/lib/proxy.hpp",
+            "src/lib/pool.hpp",
+            "src/lib/queue.hpp",
+            "src/lib/sampler.hpp",
             "src/lib/handle.hpp",
+            "src/lib/handoff.hpp",
+            "src/lib/histogram.hpp",
             "src/lib/idle.hpp",
             "src/lib/stream.hpp",
+            "src/lib/task.hpp",
             "src/lib/tcp.hpp",
+            "src/lib/timer.hpp",
+            "src/lib/upstream.hpp",
             "src/lib/util.hpp",
+            "src/lib/watchdog.hpp",
+            "src/lib/wheel.hpp",
         ],
         "dependencies": ["deps/uv/uv.gyp:libuv"],
+        # 看门狗解析调用栈的符号需要导出全部符号
+        "ldflags": ["-rdynamic"],
     },
     "targets": [
         {
@@ -36,6 +52,25 @@
                 "test/emitter.cc",
                 "test/loop.cc",
                 "test/handle.cc",
+                "test/handoff.cc",
+                "test/channel.cc",
+                "test/timer.cc",
+            ],
+        },
+        {
+            "target_name": "ccbench",
+            "type": "executable",
+            "cflags": ['-std=c++17', '-O2'],
+            "sources": [
+                "bench/bench.h",
+                "bench/main.cc",
+                "bench/async-pummel.cc",
+                "bench/million-timers.cc",
+                "bench/timer-slack.cc",
+                "bench/echo-latency.cc",
+                "bench/multi-accept.cc",
+                "bench/proxy-throughput.cc",
+                "bench/connection-pool.cc",
             ],
         },
     ],
@@ -0,0 +1,223 @@
+#ifndef UVCLS_CHANNEL_INCLUDE_H
+#define UVCLS_CHANNEL_INCLUDE_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "config.h"
+#include "emitter.hpp"
+#include "loop.hpp"
+#include "queue.hpp"
+
+/*
+两个 loop 之间的有界通道，例如解析 loop 把结果交给存储 loop。
+
+1. 数据放在无锁的 SPSCQueue 中，发送端只能在生产者 loop 线程使用，接收端只能在消费者 loop 线程使用。
+2. 队列从空变成非空时，通过消费者 loop 的 Loop::post 唤醒接收端，发布 ReadableEvent。
+3. send 失败（队列满）之后，接收端把队列消费到低水位以下时，通过生产者 loop 的 Loop::post
+   唤醒发送端，发布 WritableEvent。
+
+两端各自是 1 个 Emitter，事件只会在各自的 loop 线程中发布。
+*/
+
+namespace uvcls {
+
+// 接收端有数据可读
+struct ReadableEvent {};
+
+// 发送端在队列满之后又可以写了
+struct WritableEvent {};
+
+template <typename T>
+class Channel;
+
+template <typename T>
+class ChannelReceiver;
+
+template <typename T>
+class ChannelSender final : public Emitter<ChannelSender<T>> {
+    friend class Channel<T>;
+    friend class ChannelReceiver<T>;
+
+   public:
+    explicit ChannelSender(Channel<T> &ref) noexcept
+        : channel{ref} {}
+
+    // 队列满时返回 false，value 保持不变。之后会收到 1 次 WritableEvent
+    bool send(T value);
+
+    // 队列满时返回 false
+    bool writable() const noexcept;
+
+   private:
+    void wake();
+
+    Channel<T> &channel;
+};
+
+template <typename T>
+class ChannelReceiver final : public Emitter<ChannelReceiver<T>> {
+    friend class Channel<T>;
+    friend class ChannelSender<T>;
+
+   public:
+    explicit ChannelReceiver(Channel<T> &ref) noexcept
+        : channel{ref} {}
+
+    // 队列空时返回 false
+    bool receive(T &value);
+
+    // 依次处理队列中的全部数据，返回处理的个数
+    template <typename F>
+    std::size_t drain(F &&f);
+
+   private:
+    void wake();
+
+    Channel<T> &channel;
+};
+
+template <typename T>
+class Channel final : public std::enable_shared_from_this<Channel<T>> {
+    friend class ChannelSender<T>;
+    friend class ChannelReceiver<T>;
+
+   public:
+    // low 是低水位，队列满过之后，降到 low 以下会通知发送端
+    Channel(std::shared_ptr<Loop> producer, std::shared_ptr<Loop> consumer, std::size_t capacity, std::size_t low);
+
+    static std::shared_ptr<Channel> create(std::shared_ptr<Loop> producer, std::shared_ptr<Loop> consumer, std::size_t capacity);
+
+    static std::shared_ptr<Channel> create(std::shared_ptr<Loop> producer, std::shared_ptr<Loop> consumer, std::size_t capacity, std::size_t low);
+
+    ChannelSender<T> &sender() noexcept;
+
+    ChannelReceiver<T> &receiver() noexcept;
+
+    std::size_t size() const noexcept;
+
+    std::size_t capacity() const noexcept;
+
+   private:
+    std::shared_ptr<Loop> producerLoop;
+    std::shared_ptr<Loop> consumerLoop;
+    SPSCQueue<T> queue;
+    std::size_t low;
+    // 接收端在等待唤醒
+    alignas(CACHE_LINE) std::atomic<bool> armed{true};
+    // 发送端在等待 WritableEvent
+    alignas(CACHE_LINE) std::atomic<bool> blocked{false};
+    ChannelSender<T> tx;
+    ChannelReceiver<T> rx;
+};
+
+template <typename T>
+bool ChannelSender<T>::send(T value) {
+    if (!channel.queue.push(value)) {
+        channel.blocked.store(true, std::memory_order_seq_cst);
+
+        // 设置 blocked 之后再试 1 次，避免接收端恰好在这之前清空了队列
+        if (!channel.queue.push(value)) {
+            return false;
+        }
+    }
+
+    // 和接收端 wake 中的 fence 配对，保证不会漏掉唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (channel.armed.load(std::memory_order_relaxed) && channel.armed.exchange(false)) {
+        channel.consumerLoop->post([ptr = channel.shared_from_this()]() { ptr->rx.wake(); });
+    }
+
+    return true;
+}
+
+template <typename T>
+bool ChannelSender<T>::writable() const noexcept {
+    return channel.queue.size() < channel.queue.capacity();
+}
+
+template <typename T>
+void ChannelSender<T>::wake() {
+    this->publish(WritableEvent{});
+}
+
+template <typename T>
+bool ChannelReceiver<T>::receive(T &value) {
+    if (!channel.queue.pop(value)) {
+        return false;
+    }
+
+    if (channel.blocked.load(std::memory_order_relaxed) && channel.queue.size() <= channel.low && channel.blocked.exchange(false)) {
+        channel.producerLoop->post([ptr = channel.shared_from_this()]() { ptr->tx.wake(); });
+    }
+
+    return true;
+}
+
+template <typename T>
+template <typename F>
+std::size_t ChannelReceiver<T>::drain(F &&f) {
+    std::size_t count = 0;
+
+    for (T value{}; receive(value); ++count) {
+        f(value);
+    }
+
+    return count;
+}
+
+template <typename T>
+void ChannelReceiver<T>::wake() {
+    channel.armed.store(true, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!channel.queue.empty()) {
+        this->publish(ReadableEvent{});
+    }
+}
+
+template <typename T>
+Channel<T>::Channel(std::shared_ptr<Loop> producer, std::shared_ptr<Loop> consumer, std::size_t capacity, std::size_t lowWatermark)
+    : producerLoop{std::move(producer)},
+      consumerLoop{std::move(consumer)},
+      queue{capacity},
+      low{lowWatermark},
+      tx{*this},
+      rx{*this} {}
+
+template <typename T>
+std::shared_ptr<Channel<T>> Channel<T>::create(std::shared_ptr<Loop> producer, std::shared_ptr<Loop> consumer, std::size_t capacity) {
+    // 按取整后的实际容量取一半，否则 capacity 不是 2 的幂时低水位会偏低
+    return create(std::move(producer), std::move(consumer), capacity, SPSCQueue<T>::round(capacity) / 2);
+}
+
+template <typename T>
+std::shared_ptr<Channel<T>> Channel<T>::create(std::shared_ptr<Loop> producer, std::shared_ptr<Loop> consumer, std::size_t capacity, std::size_t low) {
+    return std::make_shared<Channel<T>>(std::move(producer), std::move(consumer), capacity, low);
+}
+
+template <typename T>
+ChannelSender<T> &Channel<T>::sender() noexcept {
+    return tx;
+}
+
+template <typename T>
+ChannelReceiver<T> &Channel<T>::receiver() noexcept {
+    return rx;
+}
+
+template <typename T>
+std::size_t Channel<T>::size() const noexcept {
+    return queue.size();
+}
+
+template <typename T>
+std::size_t Channel<T>::capacity() const noexcept {
+    return queue.capacity();
+}
+
+}  // namespace uvcls
+
+#endif
@@ -2,6 +2,8 @@
 #define UVCLS_HANDLE_INCLUDE_H
 
 #include <memory>
+#include <type_traits>
+#include <utility>
 #include "uv.h"
 #include "loop.hpp"
 #include "emitter.hpp"
@@ -10,6 +12,17 @@ namespace uvcls {
 
 struct CloseEvent {};
 
+namespace internal {
+
+// close 之前需要释放其他资源的 handle
+template<typename R, typename = void>
+struct Disposable: std::false_type {};
+
+template<typename R>
+struct Disposable<R, std::void_t<decltype(std::declval<R &>().dispose())>>: std::true_type {};
+
+}
+
 // UnderlyingType 表示底层的Loop类和libuv的handle, req 资源。
 template<typename T, typename U>
 class UnderlyingType {
@@ -89,6 +102,11 @@ public:
     // this->template 是因为 Handle 继承了模板类。close 时，事件循环为 close 阶段执行
     void close() noexcept {
         if(!closing()) {
+            // 派生类的 dispose 在这里调用，通过基类的引用关闭时也不会漏掉
+            if constexpr(internal::Disposable<T>::value) {
+                static_cast<T &>(*this).dispose();
+            }
+
             // 关闭 handle 时调用回调地址, 类的成员函数指针需要 & 符号（不像C 函数名就是指针）
             uv_close(this->template get<uv_handle_t>(), &Handle<T, U>::closeCallback);
         }
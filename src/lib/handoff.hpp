@@ -0,0 +1,495 @@
+#ifndef UVCLS_HANDOFF_INCLUDE_H
+#define UVCLS_HANDOFF_INCLUDE_H
+
+#include <uv.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "config.h"
+#include "handle.hpp"
+#include "tcp.hpp"
+#include "timer.hpp"
+
+/*
+单 acceptor + 多 worker loop 的连接分发。SO_REUSEPORT 由内核按 hash 分配连接，连接寿命差异大时
+各 loop 的负载会严重不均。这里由 1 个 acceptor loop 负责 accept，再把 fd 交给 worker loop：
+
+1. acceptor 用 server 自己的 listen：ListenEvent 中 uv_accept，或者 server 开启了 batch 时处理 AcceptedEvent，
+   所以 server 的接入控制、批量 accept 照常生效。接受的 handle dup 出 fd 交给 worker，然后关闭 acceptor 一侧的 handle
+   （dup 的 fd 还指向同 1 个 socket，不会发出 FIN）。接入控制的连接数只统计还没有交出去的连接，按 worker 限制用 active。
+2. HandoffHandle::push 把 fd 放进进程内队列，uv_async_send 唤醒 worker loop。
+3. worker 线程在 async 回调中用 TCPHandle::open 接管 fd，发布 HandoffEvent。HandoffHandle 关闭时还没有接管的
+   fd 直接关闭，之后 push 的 fd 也直接关闭。
+
+已经建立的连接也可以在 worker 之间迁移（HandoffHandle::migrate）：停止读，等待写队列清空，dup 出 fd
+之后关闭原来的 handle，再按上面的流程交给目标 worker。没有读的数据留在内核的接收缓冲中，随 fd 一起转移；
+应用层的状态（例如解析了一半的请求）通过 context 转移。
+
+Rebalancer 定期比较各 worker loop 的延迟（HandoffHandle::probe），相差超过阈值时把连接从最慢的
+worker 迁移到最快的 worker。迁移每个连接之前在源 worker 上发布 MigrateEvent，应用可以提供 context 或者否决。
+迁移过程中写失败时关闭连接，在目标 worker 上发布 ErrorEvent。
+*/
+
+namespace uvcls {
+
+// worker loop 接管连接后发布。handle 已经 init 并 open，还没有开始 read
+struct HandoffEvent {
+    std::shared_ptr<TCPHandle> handle;
+    std::shared_ptr<void> context{nullptr}; /*!< 迁移时随连接转移的应用层状态 */
+};
+
+// rebalance 迁移 1 个连接之前在源 worker 的 loop 线程中发布
+struct MigrateEvent {
+    std::shared_ptr<TCPHandle> handle;
+    std::shared_ptr<void> &context; /*!< 随连接转移的应用层状态，监听函数负责设置 */
+    bool &veto;                      /*!< 设为 true 时这个连接留在源 worker */
+};
+
+// Rebalancer 决定迁移时发布，from 和 to 是 add 的顺序
+struct RebalanceEvent {
+    std::size_t from;
+    std::size_t to;
+    std::chrono::microseconds gap; /*!< 两个 loop 的延迟之差 */
+};
+
+// worker 的选择策略
+enum class Balance {
+    ROUND_ROBIN,
+    LEAST_CONNECTIONS
+};
+
+// worker loop 一侧的接收端，属于 worker loop。
+class HandoffHandle final : public Handle<HandoffHandle, uv_async_t> {
+    static void sendCallback(uv_async_t *handle);
+
+   public:
+    using Handle::Handle;
+
+    // uv_async_init 不是线程安全的，要在 worker loop 运行之前或者在 worker 线程中调用
+    bool init();
+
+    // Handle::close 调用：之后 push 的 fd 直接关闭，关闭队列中还没有接管的 fd
+    void dispose() noexcept;
+
+    // 线程安全。fd 的所有权交给 worker loop，worker 已经关闭时直接关闭 fd
+    void push(OSSocketHandle socket, std::shared_ptr<void> context = nullptr);
+
+    // worker 上存活的连接数（包括还在队列中的），线程安全
+    std::size_t active() const noexcept;
+
+    // 把 handle 迁移到这个 worker，只能在 handle 所在的 loop 线程中调用。开始迁移之后不能再写。
+    // 等待写队列清空时写失败，handle 会被关闭，这个 worker 发布 ErrorEvent
+    void migrate(std::shared_ptr<TCPHandle> handle, std::shared_ptr<void> context = nullptr);
+
+    // 把这个 worker 接管的最多 count 个连接迁移到 target，只能在这个 worker 的 loop 线程中调用。
+    // 每个连接先发布 MigrateEvent，被否决的留下。返回迁移的个数
+    std::size_t rebalance(std::size_t count, std::shared_ptr<HandoffHandle> target);
+
+    // 开始测量 worker loop 的延迟：每隔 interval 触发 1 次定时器，记录实际触发时间比预期晚了多少
+    void probe(std::chrono::milliseconds interval);
+
+    // 最近的 loop 延迟（指数平均），线程安全
+    std::chrono::microseconds lag() const noexcept;
+
+   private:
+    struct Adoption {
+        uv_os_sock_t sock;
+        std::shared_ptr<void> context;
+    };
+
+    // 写队列清空之后交出 fd
+    void transfer(TCPHandle &handle, std::shared_ptr<void> context);
+
+    std::mutex mutex{};
+    std::vector<Adoption> pending{};
+    // close 之后 async handle 不能再 send，和 pending 一起由 mutex 保护
+    bool closed{false};
+    // 在 worker 线程中和 pending 交换，容量可以复用
+    std::vector<Adoption> adopting{};
+    std::atomic<std::size_t> count{0};
+    // 接管的连接，rebalance 时从这里挑选
+    std::vector<std::weak_ptr<TCPHandle>> connections{};
+    std::shared_ptr<TimerHandle> prober{nullptr};
+    std::uint64_t fired{0};
+    std::atomic<std::uint64_t> delay{0};
+};
+
+/*
+按 loop 延迟做负载均衡。每个 worker 需要先调用 probe；Rebalancer 自己的定时器运行在构造时传入的 loop 上。
+每次检查时，延迟最大和最小的 worker 相差超过 threshold，就在慢的 worker 线程中把 batch 个连接迁移到快的 worker。
+*/
+class Rebalancer final : public Emitter<Rebalancer>, public std::enable_shared_from_this<Rebalancer> {
+   public:
+    Rebalancer(std::shared_ptr<Loop> ref, std::chrono::microseconds threshold, std::size_t batch = 1);
+
+    void add(std::shared_ptr<HandoffHandle> worker);
+
+    // 每隔 interval 检查 1 次
+    void start(std::chrono::milliseconds interval);
+
+    void stop();
+
+   private:
+    void check();
+
+    std::shared_ptr<Loop> loop;
+    std::shared_ptr<TimerHandle> timer{nullptr};
+    std::vector<std::shared_ptr<HandoffHandle>> workers{};
+    std::chrono::microseconds limit;
+    std::size_t size;
+};
+
+// acceptor loop 一侧。监听 server 的 ListenEvent（或者 AcceptedEvent），把新连接分发给 worker。
+class Acceptor final : public Emitter<Acceptor>, public std::enable_shared_from_this<Acceptor> {
+   public:
+    explicit Acceptor(std::shared_ptr<TCPHandle> ref, Balance policy = Balance::ROUND_ROBIN);
+
+    // 需要在 listen 之前添加
+    void add(std::shared_ptr<HandoffHandle> worker);
+
+    // server 需要已经 bind，batch、admission 可以在 listen 之前或者之后设置。server 关闭时停止 accept
+    void listen(int backlog = 1024);
+
+    std::size_t size() const noexcept;
+
+   private:
+    HandoffHandle &next() noexcept;
+
+    // 把 accept 得到的 handle 的 fd 交给 worker，关闭 handle
+    void dispatch(TCPHandle &handle);
+
+    std::shared_ptr<TCPHandle> server;
+    std::vector<std::shared_ptr<HandoffHandle>> workers{};
+    Balance balance;
+    std::size_t cursor{0};
+};
+
+UVCLS_INLINE void HandoffHandle::sendCallback(uv_async_t *handle) {
+    HandoffHandle &ref = *(static_cast<HandoffHandle *>(handle->data));
+
+    {
+        std::lock_guard<std::mutex> lock{ref.mutex};
+        ref.adopting.swap(ref.pending);
+    }
+
+    for (auto &[sock, context] : ref.adopting) {
+        // HandoffEvent 的监听函数可能关闭 worker
+        if (ref.closing()) {
+            ::close(sock);
+            ref.count--;
+            continue;
+        }
+
+        auto tcp = ref.loop().resource<TCPHandle>();
+        int err = tcp ? 0 : UV_ENOMEM;
+
+        if (tcp) {
+            // 新的 handle 上没有其他监听函数，open 之后清掉即可
+            tcp->once<ErrorEvent>([&err](const auto &event, auto &) { err = event.code(); });
+            tcp->open(sock);
+            tcp->clear<ErrorEvent>();
+        }
+
+        if (err) {
+            ::close(sock);
+            ref.count--;
+            ref.publish(ErrorEvent{err});
+
+            if (tcp) {
+                tcp->close();
+            }
+        } else {
+            // 连接关闭时 worker 的计数减 1，least connections 依赖这个计数
+            tcp->once<CloseEvent>([ptr = ref.shared_from_this()](const auto &, auto &) { ptr->count--; });
+            ref.connections.push_back(tcp);
+            ref.publish(HandoffEvent{std::move(tcp), std::move(context)});
+        }
+    }
+
+    ref.adopting.clear();
+}
+
+UVCLS_INLINE bool HandoffHandle::init() {
+    return initialize(&uv_async_init, &sendCallback);
+}
+
+UVCLS_INLINE void HandoffHandle::dispose() noexcept {
+    // 在 uv_close 之前调用，之后不会再有 async 回调
+    std::lock_guard<std::mutex> lock{mutex};
+    closed = true;
+
+    for (auto &adoption : pending) {
+        ::close(adoption.sock);
+        count--;
+    }
+
+    pending.clear();
+}
+
+UVCLS_INLINE void HandoffHandle::push(OSSocketHandle socket, std::shared_ptr<void> context) {
+    std::lock_guard<std::mutex> lock{mutex};
+
+    if (closed) {
+        ::close(socket);
+        return;
+    }
+
+    count++;
+    pending.push_back(Adoption{socket, std::move(context)});
+    // 在锁内 send，dispose 之后不会再 send。多次 send 在 libuv 中会被合并为 1 次唤醒
+    uv_async_send(get());
+}
+
+UVCLS_INLINE std::size_t HandoffHandle::active() const noexcept {
+    return count.load(std::memory_order_relaxed);
+}
+
+UVCLS_INLINE void HandoffHandle::migrate(std::shared_ptr<TCPHandle> handle, std::shared_ptr<void> context) {
+    handle->stop();
+
+    if (handle->writeQueueSize() == 0) {
+        transfer(*handle, std::move(context));
+    } else {
+        // 还有没写完的数据，等写完之后再检查 1 次。写失败时连接已经不能用，关闭它，源 worker 的计数随之释放
+        auto settled = std::make_shared<bool>(false);
+
+        handle->once<WriteEvent>([ptr = shared_from_this(), context = std::move(context), settled](const auto &, auto &hndl) mutable {
+            if (!std::exchange(*settled, true)) {
+                ptr->migrate(hndl.shared_from_this(), std::move(context));
+            }
+        });
+        handle->once<ErrorEvent>([ptr = shared_from_this(), settled](const ErrorEvent &event, auto &hndl) {
+            if (!std::exchange(*settled, true)) {
+                hndl.close();
+                ptr->publish(ErrorEvent{event.code()});
+            }
+        });
+    }
+}
+
+UVCLS_INLINE void HandoffHandle::transfer(TCPHandle &handle, std::shared_ptr<void> context) {
+    uv_os_fd_t fd;
+
+    if (auto err = uv_fileno(handle.get<uv_handle_t>(), &fd); err) {
+        publish(ErrorEvent{err});
+    } else if (auto sock = ::dup(fd); sock < 0) {
+        publish(ErrorEvent{ErrorEvent::translate(errno)});
+    } else {
+        // 先关闭原来的 handle，新的 worker 只会看到 dup 出来的 fd
+        handle.close();
+        push(sock, std::move(context));
+    }
+}
+
+UVCLS_INLINE std::size_t HandoffHandle::rebalance(std::size_t limit, std::shared_ptr<HandoffHandle> target) {
+    std::size_t moved = 0;
+
+    // 顺便清理已经关闭的连接
+    connections.erase(std::remove_if(connections.begin(), connections.end(), [](auto &wptr) {
+        auto ptr = wptr.lock();
+        return !ptr || ptr->closing();
+    }), connections.end());
+
+    std::vector<std::weak_ptr<TCPHandle>> kept;
+
+    // 优先迁移最新接管的连接，老连接的缓存更热
+    while (moved < limit && !connections.empty()) {
+        auto ptr = connections.back().lock();
+        connections.pop_back();
+
+        std::shared_ptr<void> context{nullptr};
+        bool veto = false;
+        publish(MigrateEvent{ptr, context, veto});
+
+        // 监听函数可能关闭了连接
+        if (ptr->closing()) {
+            continue;
+        } else if (veto) {
+            kept.push_back(std::move(ptr));
+        } else {
+            target->migrate(std::move(ptr), std::move(context));
+            ++moved;
+        }
+    }
+
+    connections.insert(connections.end(), kept.rbegin(), kept.rend());
+    return moved;
+}
+
+UVCLS_INLINE void HandoffHandle::probe(std::chrono::milliseconds interval) {
+    if (!prober) {
+        prober = loop().resource<TimerHandle>();
+
+        if (!prober) {
+            return;
+        }
+
+        // 定时器是 ref 的，worker 关闭时一起关闭
+        once<CloseEvent>([timer = prober](const auto &, auto &) { timer->close(); });
+    }
+
+    prober->clear<TimerEvent>();
+    prober->on<TimerEvent>([this, period = static_cast<std::uint64_t>(interval.count()) * 1000000](const auto &, auto &) {
+        auto now = uv_hrtime();
+        auto sample = now > fired + period ? now - fired - period : 0;
+        // 和 TCP 的 srtt 一样取 1/8 的新样本
+        delay.store((delay.load(std::memory_order_relaxed) * 7 + sample) / 8, std::memory_order_relaxed);
+        fired = now;
+    });
+
+    fired = uv_hrtime();
+    prober->start(TimerHandle::Time{interval.count()}, TimerHandle::Time{interval.count()});
+}
+
+UVCLS_INLINE std::chrono::microseconds HandoffHandle::lag() const noexcept {
+    return std::chrono::microseconds{delay.load(std::memory_order_relaxed) / 1000};
+}
+
+UVCLS_INLINE Rebalancer::Rebalancer(std::shared_ptr<Loop> ref, std::chrono::microseconds threshold, std::size_t batch)
+    : loop{std::move(ref)}, limit{threshold}, size{batch} {}
+
+UVCLS_INLINE void Rebalancer::add(std::shared_ptr<HandoffHandle> worker) {
+    workers.push_back(std::move(worker));
+}
+
+UVCLS_INLINE void Rebalancer::start(std::chrono::milliseconds interval) {
+    if (!timer) {
+        timer = loop->resource<TimerHandle>();
+
+        if (!timer) {
+            return;
+        }
+
+        timer->on<TimerEvent>([wptr = weak_from_this()](const auto &, auto &) {
+            if (auto ptr = wptr.lock(); ptr) {
+                ptr->check();
+            }
+        });
+    }
+
+    timer->start(TimerHandle::Time{interval.count()}, TimerHandle::Time{interval.count()});
+}
+
+UVCLS_INLINE void Rebalancer::stop() {
+    if (timer) {
+        timer->close();
+        timer = nullptr;
+    }
+}
+
+UVCLS_INLINE void Rebalancer::check() {
+    if (workers.size() < 2) {
+        return;
+    }
+
+    std::size_t hot = 0;
+    std::size_t cold = 0;
+
+    for (std::size_t pos = 1; pos < workers.size(); ++pos) {
+        if (workers[pos]->lag() > workers[hot]->lag()) {
+            hot = pos;
+        }
+
+        if (workers[pos]->lag() < workers[cold]->lag()) {
+            cold = pos;
+        }
+    }
+
+    if (auto gap = workers[hot]->lag() - workers[cold]->lag(); gap > limit && workers[hot]->active()) {
+        publish(RebalanceEvent{hot, cold, gap});
+
+        // 连接只能在自己的 loop 线程中迁移
+        workers[hot]->loop().post([from = workers[hot], to = workers[cold], batch = size]() {
+            if (!from->closing()) {
+                from->rebalance(batch, to);
+            }
+        });
+    }
+}
+
+UVCLS_INLINE Acceptor::Acceptor(std::shared_ptr<TCPHandle> ref, Balance policy)
+    : server{std::move(ref)}, balance{policy} {}
+
+UVCLS_INLINE void Acceptor::add(std::shared_ptr<HandoffHandle> worker) {
+    workers.push_back(std::move(worker));
+}
+
+UVCLS_INLINE std::size_t Acceptor::size() const noexcept {
+    return workers.size();
+}
+
+UVCLS_INLINE void Acceptor::listen(int backlog) {
+    // 捕获 weak_ptr，避免 server -> listener -> acceptor -> server 的循环引用
+    server->on<ListenEvent>([wptr = weak_from_this()](const auto &, auto &srv) {
+        if (auto ptr = wptr.lock(); ptr) {
+            if (auto handle = srv.loop().template resource<TCPHandle>(); handle) {
+                srv.accept(*handle);
+                ptr->dispatch(*handle);
+            }
+        }
+    });
+    server->on<AcceptedEvent<TCPHandle>>([wptr = weak_from_this()](const auto &event, auto &) {
+        if (auto ptr = wptr.lock(); ptr) {
+            for (auto &handle : event) {
+                ptr->dispatch(*handle);
+            }
+        }
+    });
+    server->listen(backlog);
+}
+
+UVCLS_INLINE HandoffHandle &Acceptor::next() noexcept {
+    if (balance == Balance::LEAST_CONNECTIONS) {
+        auto least = std::numeric_limits<std::size_t>::max();
+
+        for (std::size_t pos = 0; pos < workers.size(); ++pos) {
+            if (auto active = workers[pos]->active(); active < least) {
+                least = active;
+                cursor = pos;
+            }
+        }
+    } else {
+        cursor = (cursor + 1) % workers.size();
+    }
+
+    return *workers[cursor];
+}
+
+UVCLS_INLINE void Acceptor::dispatch(TCPHandle &handle) {
+    uv_os_fd_t fd;
+
+    // uv_accept 失败时 server 已经发布了 ErrorEvent
+    if (uv_fileno(handle.get<uv_handle_t>(), &fd)) {
+        handle.close();
+        return;
+    }
+
+    if (workers.empty()) {
+        handle.close();
+        publish(ErrorEvent{static_cast<int>(UV_ENOENT)});
+        return;
+    }
+
+    auto sock = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    handle.close();
+
+    if (sock < 0) {
+        publish(ErrorEvent{ErrorEvent::translate(errno)});
+    } else {
+        next().push(sock);
+    }
+}
+
+}  // namespace uvcls
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef UVCLS_HISTOGRAM_INCLUDE_H
+#define UVCLS_HISTOGRAM_INCLUDE_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include "config.h"
+
+/*
+延迟的直方图，log-linear 分桶（和 HdrHistogram 的思路相同）：
+
+1. 小于 SUB 的值每个值 1 个桶；之后每个 2 的幂区间 [2^k, 2^(k+1)) 等分成 SUB 个桶，相对误差不超过 1 / SUB。
+2. 单位是纳秒，覆盖 [0, 2^40) ns（约 18 分钟），更大的值记入最后 1 个桶。
+3. 记录是 O(1) 的位运算，不申请内存；分位数从小到大累加桶的计数，返回桶的上界。
+*/
+
+namespace uvcls {
+
+class LatencyHistogram final {
+    static constexpr unsigned int SUB_BITS = 3;
+    static constexpr unsigned int RANGE_BITS = 40;
+
+   public:
+    static constexpr std::uint64_t SUB = std::uint64_t{1} << SUB_BITS;
+    static constexpr std::size_t BUCKETS = (RANGE_BITS - SUB_BITS + 1) * SUB;
+
+    void record(std::chrono::nanoseconds value) noexcept;
+
+    // q 在 [0, 1] 之间，没有记录时返回 0
+    std::chrono::nanoseconds percentile(double q) const noexcept;
+
+    std::uint64_t count() const noexcept;
+
+    std::chrono::nanoseconds max() const noexcept;
+
+    void reset() noexcept;
+
+   private:
+    static std::size_t index(std::uint64_t value) noexcept;
+
+    // 桶中最大的值
+    static std::uint64_t upper(std::size_t bucket) noexcept;
+
+    std::array<std::uint64_t, BUCKETS> buckets{};
+    std::uint64_t total{0};
+    std::uint64_t maximum{0};
+};
+
+UVCLS_INLINE void LatencyHistogram::record(std::chrono::nanoseconds value) noexcept {
+    // 时钟调整可能得到负数
+    auto ns = static_cast<std::uint64_t>(std::max<std::chrono::nanoseconds::rep>(value.count(), 0));
+    buckets[index(ns)]++;
+    total++;
+    maximum = std::max(maximum, ns);
+}
+
+UVCLS_INLINE std::chrono::nanoseconds LatencyHistogram::percentile(double q) const noexcept {
+    if (!total) {
+        return std::chrono::nanoseconds{0};
+    }
+
+    auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(total))));
+    std::uint64_t seen = 0;
+
+    for (std::size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+        if (seen += buckets[bucket]; seen >= rank) {
+            return std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(std::min(upper(bucket), maximum))};
+        }
+    }
+
+    return max();
+}
+
+UVCLS_INLINE std::uint64_t LatencyHistogram::count() const noexcept {
+    return total;
+}
+
+UVCLS_INLINE std::chrono::nanoseconds LatencyHistogram::max() const noexcept {
+    return std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(maximum)};
+}
+
+UVCLS_INLINE void LatencyHistogram::reset() noexcept {
+    buckets.fill(0);
+    total = 0;
+    maximum = 0;
+}
+
+UVCLS_INLINE std::size_t LatencyHistogram::index(std::uint64_t value) noexcept {
+    value = std::min(value, (std::uint64_t{1} << RANGE_BITS) - 1);
+
+    if (value < SUB) {
+        return static_cast<std::size_t>(value);
+    }
+
+    // 最高位之后的 SUB_BITS 位决定区间内的桶
+    auto shift = static_cast<unsigned int>(63 - __builtin_clzll(value)) - SUB_BITS;
+    return static_cast<std::size_t>((shift + 1) * SUB + ((value >> shift) - SUB));
+}
+
+UVCLS_INLINE std::uint64_t LatencyHistogram::upper(std::size_t bucket) noexcept {
+    if (bucket < SUB) {
+        return bucket;
+    }
+
+    auto shift = static_cast<unsigned int>(bucket / SUB - 1);
+    auto lower = (SUB + bucket % SUB) << shift;
+    return lower + (std::uint64_t{1} << shift) - 1;
+}
+
+}  // namespace uvcls
+
+#endif
@@ -2,52 +2,256 @@
 #define UVCLS_LOOP_INCLUDE_H
 
 #include <uv.h>
+#ifndef _WIN32
+#include <poll.h>
+#endif
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "emitter.hpp"
+#include "numa.hpp"
+#include "pool.hpp"
+#include "queue.hpp"
+#include "task.hpp"
+#include "watchdog.hpp"
+#include "wheel.hpp"
 
 namespace uvcls {
 
-// 枚举定义 loop 的三种运行模式。uv_run_mode 是枚举
+// 枚举定义 loop 的运行模式。uv_run_mode 是枚举，SPIN 是 uvcls 自己的忙轮询模式
 enum class UVRunMode : std::underlying_type_t<uv_run_mode> {
     DEFAULT = UV_RUN_DEFAULT,
     ONCE = UV_RUN_ONCE,
-    NOWAIT = UV_RUN_NOWAIT
+    NOWAIT = UV_RUN_NOWAIT,
+    SPIN
+};
+
+/*
+SPIN 模式的退避预算，按 loop 连续空闲的时间划分：
+空闲 < spin 时紧密轮询，< pause 时每轮执行 pause 指令，< yield 时让出 CPU，之后阻塞在 epoll 上。
+*/
+struct SpinBudget {
+    std::chrono::microseconds spin{50};
+    std::chrono::microseconds pause{200};
+    std::chrono::microseconds yield{1000};
+};
+
+// loop 的运行统计
+struct LoopMetrics {
+    std::uint64_t iterations{0}; /*!< 执行的轮数 */
+    std::uint64_t wakeups{0};    /*!< 阻塞在 poll 上之后被唤醒的次数 */
+    std::uint64_t signals{0};    /*!< post 调用 uv_async_send 的次数，1 批任务只有第 1 个调用 */
+    std::uint64_t asyncs{0};     /*!< post 的任务唤醒 loop 的次数（async 回调） */
+    double seconds{0};           /*!< 统计的时长 */
+
+    // 每秒唤醒的次数
+    double rate() const noexcept {
+        return seconds > 0 ? static_cast<double>(wakeups) / seconds : 0;
+    }
 };
 
 enum class UVLoopOption : std::underlying_type_t<uv_loop_option> {
     BLOCK_SIGNAL = UV_LOOP_BLOCK_SIGNAL,
 };
 
+namespace internal {
+
+// 判断资源是否需要 init（handle 需要，req 不需要）
+template <typename R, typename = void>
+struct Initializable : std::false_type {};
+
+template <typename R>
+struct Initializable<R, std::void_t<decltype(std::declval<R &>().init())>> : std::true_type {};
+
+// 忙等待时降低功耗，并让出超线程的执行资源
+inline void relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// loop 自己的 handle。析构时还有其他 handle 的话，它们和 uv_loop_t 一起泄漏，不随 Loop 释放
+struct LoopCore {
+    uv_async_t async{};
+    uv_prepare_t prepare{};
+    uv_check_t check{};
+};
+
+}  // namespace internal
+
 class Loop final : public Emitter<Loop>, public std::enable_shared_from_this<Loop> {
     // 释放 uv_loop_t 占的空间
     using Deleter = void (*)(uv_loop_t *);
+    using Task = std::function<void()>;
+
+    static void postCallback(uv_async_t *handle);
+
+    static void prepareCallback(uv_prepare_t *handle);
+
+    static void checkCallback(uv_check_t *handle);
 
     template <typename, typename>
     friend class Resource;
 
    public:
+    using Time = std::chrono::duration<std::uint64_t, std::milli>;
+    using HRTime = std::chrono::duration<std::uint64_t, std::nano>;
+
     // 获取 Loop 类默认实例
     static std::shared_ptr<Loop> getDefault();
 
+    // 创建 1 个新的 Loop（非默认），多个 loop 各自运行在自己的线程中
+    static std::shared_ptr<Loop> create();
+
+    // 创建绑定到 cpus 的 Loop。第一次 run 时把运行 loop 的线程绑定到这些核上
+    static std::shared_ptr<Loop> create(std::vector<unsigned int> cpus);
+
     Loop(std::unique_ptr<uv_loop_t, Deleter> ptr) noexcept;
 
     ~Loop() noexcept;
 
+    // 还有其他 handle 或者 req 时发布 UV_EBUSY，loop 保持原样（post、defer 仍然可用），不会执行回调
     void close();
 
     template <UVRunMode mode = UVRunMode::DEFAULT>
     bool run() noexcept;
 
+    // 处理事件，直到用完 budget 或者 loop 没有活动的 handle。后者返回 true
+    template <typename Rep, typename Period>
+    bool runFor(std::chrono::duration<Rep, Period> budget) noexcept;
+
     void stop() noexcept;
 
+    // 嵌入到其他事件循环：宿主监听 descriptor() 的可读事件，最多等待 timeout() 毫秒（-1 表示不限），
+    // 然后调用 run<UVRunMode::NOWAIT>()
+    int descriptor() const noexcept;
+
+    int timeout() const noexcept;
+
+    // loop 中是否还有活动的 handle 或者 req
+    bool alive() const noexcept;
+
+    // 设置 SPIN 模式的退避预算
+    void spin(SpinBudget budget) noexcept;
+
+    // 创建属于当前 loop 的资源。handle 会自动 init，失败时返回 nullptr
+    template <typename R, typename... Args>
+    std::shared_ptr<R> resource(Args &&...args);
+
+    // 线程安全。在 loop 线程中执行 task，同一批 post 只唤醒 loop 1 次
+    void post(Task task);
+
+    // post 的 async handle 默认是 unref 的，loop 没有其他 handle 时 run 会返回。打开之后 loop 一直等待 post 的任务，
+    // 直到再次关闭。不是线程安全的，在 run 之前或者在 loop 线程中（例如 post 的任务中）调用
+    void keepAlive(bool enable) noexcept;
+
+    // 只能在 loop 线程中调用。task 在当前阶段的回调都执行完之后、loop 阻塞在 poll 之前执行，
+    // task 中再 defer 的也会在这之前执行完
+    void defer(Task task);
+
+    // 底层的 uv_loop_t，用于直接调用 libuv 的接口
+    uv_loop_t *raw() noexcept;
+
+    // loop 第一次 run 时所在的核和 NUMA 节点
+    Placement placement() const;
+
+    // loop 的读缓冲池，只能在 loop 线程中使用。第一次调用时在当前节点上分配
+    BufferPool &buffers();
+
+    // loop 的时间轮，大量逻辑定时器共用 1 个 uv_timer_t。只能在 loop 线程中使用
+    TimerWheel &wheel();
+
+    // loop 的毫秒时间（uv_now），每轮开始和 poll 返回时更新
+    Time now() const noexcept;
+
+    // 纳秒时间。每个阶段（poll 之前、poll 之后）第一次调用时读 1 次时钟，之后返回缓存的值
+    HRTime hrnow() noexcept;
+
+    // 立即更新 now() 和 hrnow()，用于回调中执行了耗时的操作之后
+    void updateTime() noexcept;
+
+    // 提交 1 个协作式的长任务，只能在 loop 线程中调用
+    void spawn(Scheduler::Job job, Priority priority = Priority::NORMAL);
+
+    // loop 的任务调度器，用于设置时间片。只能在 loop 线程中使用
+    Scheduler &scheduler();
+
+    // loop 的看门狗，第一次调用时创建，start 之后才会启动线程
+    Watchdog &watchdog();
+
+    // 当前是第几轮，单调递增，不受 metrics(true) 影响。用于按轮计数
+    std::uint64_t iteration() const noexcept;
+
+    // 从创建（或者上一次 reset）到现在的统计，只能在 loop 线程中调用
+    LoopMetrics metrics(bool reset = false) noexcept;
+
    private:
+    // 每次 run 时记录 loop 线程（看门狗和缓冲池使用），第一次 run 时绑定 CPU 并记录位置
+    void place() noexcept;
+
+    // SPIN 模式的主循环
+    bool spin() noexcept;
+
+    // 是否有事件（或者到期的定时器）等待处理
+    bool ready() noexcept;
+
+    // 以 mode 执行 1 次 uv_run
+    int execute(uv_run_mode mode) noexcept;
+
+    // runFor 的主循环，end 是 uv_hrtime 的纳秒数
+    bool until(std::uint64_t end) noexcept;
+
+    // 执行 defer 的任务，直到队列为空
+    void drain();
+
+    // 除了 loop 自己的 handle 之外，是否还有 handle、req 或者 defer 的任务
+    bool busy() const noexcept;
+
+    bool owns(const uv_handle_t *handle) const noexcept;
+
     std::unique_ptr<uv_loop_t, Deleter> loop;
+    // async 给 post 使用，默认 unref，不会让 loop 一直存活，见 keepAlive。
+    // prepare、check 每轮 poll 前后执行，用于统计和 defer。同样是 unref 的，有 defer 的任务时 ref
+    std::unique_ptr<internal::LoopCore> core;
+    MPSCQueue<Task> tasks{};
+    // post 调用 uv_async_send 的次数，生产者线程写
+    std::atomic<std::uint64_t> signals{0};
+    std::uint64_t signalled{0};
+    // defer 的双缓冲，clear 之后保留容量
+    std::vector<Task> deferred{};
+    std::vector<Task> draining{};
+    SpinBudget spinBudget{};
+    bool stopped{false};
+    Placement where{};
+    bool placed{false};
+    // 最近 1 次 run 的线程
+    std::thread::id runner{};
+    std::unique_ptr<BufferPool> pool{nullptr};
+    std::unique_ptr<TimerWheel> timers{nullptr};
+    std::unique_ptr<Scheduler> jobs{nullptr};
+    // 看门狗引用 heartbeat，要先于它析构
+    internal::Heartbeat heartbeat{};
+    std::unique_ptr<Watchdog> dog{nullptr};
+    LoopMetrics counters{};
+    std::uint64_t rounds{0};
+    std::uint64_t since{0};
+    // hrnow 的缓存，fresh 为 false 时重新读时钟
+    std::uint64_t hrtime{0};
+    bool fresh{false};
+    // 本轮 poll 是否会阻塞
+    bool blocking{false};
+    bool nowait{false};
     std::shared_ptr<void> userData{nullptr};
 };
 
@@ -70,29 +274,445 @@ UVCLS_INLINE std::shared_ptr<Loop> Loop::getDefault() {
     return loop;
 }
 
+UVCLS_INLINE std::shared_ptr<Loop> Loop::create() {
+    auto ptr = std::unique_ptr<uv_loop_t, Deleter>{new uv_loop_t, [](uv_loop_t *l) { delete l; }};
+    return uv_loop_init(ptr.get()) ? nullptr : std::shared_ptr<Loop>{new Loop{std::move(ptr)}};
+}
+
+template <typename R, typename... Args>
+std::shared_ptr<R> Loop::resource(Args &&...args) {
+    auto ptr = std::make_shared<R>(shared_from_this(), std::forward<Args>(args)...);
+
+    if constexpr (internal::Initializable<R>::value) {
+        ptr = ptr->init() ? ptr : nullptr;
+    }
+
+    return ptr;
+}
+
+UVCLS_INLINE std::shared_ptr<Loop> Loop::create(std::vector<unsigned int> cpus) {
+    auto loop = create();
+
+    if (loop) {
+        loop->where.cpus = std::move(cpus);
+    }
+
+    return loop;
+}
+
 template <UVRunMode mode>
 bool Loop::run() noexcept {
-    auto utm = static_cast<std::underlying_type_t<UVRunMode>>(mode);
-    auto uvrm = static_cast<uv_run_mode>(utm);
-    return (uv_run(loop.get(), uvrm) == 0);
+    place();
+
+    if constexpr (mode == UVRunMode::SPIN) {
+        return spin();
+    } else {
+        auto utm = static_cast<std::underlying_type_t<UVRunMode>>(mode);
+        auto uvrm = static_cast<uv_run_mode>(utm);
+        return (execute(uvrm) == 0);
+    }
+}
+
+template <typename Rep, typename Period>
+bool Loop::runFor(std::chrono::duration<Rep, Period> budget) noexcept {
+    place();
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(budget).count();
+    return until(uv_hrtime() + static_cast<std::uint64_t>(ns > 0 ? ns : 0));
+}
+
+UVCLS_INLINE bool Loop::until(std::uint64_t end) noexcept {
+    stopped = false;
+
+    for (auto now = uv_hrtime(); !stopped && alive() && now < end; now = uv_hrtime()) {
+        // 阻塞的时间不超过剩余的预算，NOWAIT 负责处理就绪的事件和到期的定时器
+        auto wait = static_cast<int>((end - now + 999999) / 1000000);
+        uv_update_time(loop.get());
+        auto pending = timeout();
+
+        if (!deferred.empty()) {
+            pending = 0;
+        }
+
+#ifndef _WIN32
+        if (pending != 0) {
+            pollfd pfd{descriptor(), POLLIN, 0};
+            ::poll(&pfd, 1, pending < 0 ? wait : std::min(wait, pending));
+        }
+#endif
+
+        execute(UV_RUN_NOWAIT);
+    }
+
+    return !alive();
+}
+
+UVCLS_INLINE int Loop::descriptor() const noexcept {
+    return uv_backend_fd(loop.get());
+}
+
+UVCLS_INLINE int Loop::timeout() const noexcept {
+    return uv_backend_timeout(loop.get());
+}
+
+UVCLS_INLINE bool Loop::alive() const noexcept {
+    return uv_loop_alive(loop.get()) != 0;
 }
 
 UVCLS_INLINE void Loop::stop() noexcept {
+    stopped = true;
     uv_stop(loop.get());
 }
 
+UVCLS_INLINE void Loop::spin(SpinBudget budget) noexcept {
+    spinBudget = budget;
+}
+
+UVCLS_INLINE bool Loop::ready() noexcept {
+    // uv_backend_timeout 按缓存的 loop 时间计算，空转期间不更新的话，到期的定时器要等到退避结束
+    uv_update_time(loop.get());
+
+    if (!deferred.empty() || uv_backend_timeout(loop.get()) == 0) {
+        return true;
+    }
+
+#ifndef _WIN32
+    // epoll/kqueue 的 fd 本身可以 poll，有就绪事件时可读。空闲时只需要这 1 次系统调用
+    pollfd pfd{uv_backend_fd(loop.get()), POLLIN, 0};
+    return ::poll(&pfd, 1, 0) != 0;
+#else
+    return true;
+#endif
+}
+
+UVCLS_INLINE bool Loop::spin() noexcept {
+    using namespace std::chrono;
+
+    auto idle = steady_clock::now();
+    stopped = false;
+
+    while (!stopped && alive()) {
+        if (ready()) {
+            execute(UV_RUN_NOWAIT);
+            idle = steady_clock::now();
+            continue;
+        }
+
+        auto elapsed = steady_clock::now() - idle;
+
+        if (elapsed < spinBudget.spin) {
+            continue;
+        } else if (elapsed < spinBudget.pause) {
+            internal::relax();
+        } else if (elapsed < spinBudget.yield) {
+            std::this_thread::yield();
+        } else {
+            // 空闲太久，退回到阻塞的 epoll_wait
+            execute(UV_RUN_ONCE);
+            idle = steady_clock::now();
+        }
+    }
+
+    return !alive();
+}
+
 UVCLS_INLINE void Loop::close() {
+    // 不关闭内部的 handle，调用者关闭剩下的 handle 之后可以再次 close
+    if (busy()) {
+        return publish(ErrorEvent{static_cast<int>(UV_EBUSY)});
+    }
+
+    if (dog) {
+        dog->stop();
+    }
+
+    // 只剩下 loop 内部的 handle，它们的 close 回调为空，跑 1 次 loop 不会执行其他回调
+    if (!uv_is_closing(reinterpret_cast<uv_handle_t *>(&core->async))) {
+        uv_close(reinterpret_cast<uv_handle_t *>(&core->async), nullptr);
+        uv_close(reinterpret_cast<uv_handle_t *>(&core->prepare), nullptr);
+        uv_close(reinterpret_cast<uv_handle_t *>(&core->check), nullptr);
+
+        if (timers) {
+            timers->close();
+        }
+
+        if (jobs) {
+            jobs->close();
+        }
+
+        uv_run(loop.get(), UV_RUN_NOWAIT);
+    }
+
     auto err = uv_loop_close(loop.get());
     return err ? publish(ErrorEvent{err}) : loop.reset();
 }
 
+UVCLS_INLINE bool Loop::busy() const noexcept {
+    if (loop->active_reqs.count || !deferred.empty()) {
+        return true;
+    }
+
+    std::pair<const Loop *, bool> state{this, false};
+
+    // uv_walk 会跳过 libuv 内部的 handle（线程池的 async 等），包括正在关闭的 handle
+    uv_walk(loop.get(), [](uv_handle_t *handle, void *arg) {
+        auto &[self, found] = *static_cast<std::pair<const Loop *, bool> *>(arg);
+        found = found || !self->owns(handle);
+    }, &state);
+
+    return state.second;
+}
+
+UVCLS_INLINE bool Loop::owns(const uv_handle_t *handle) const noexcept {
+    if (handle == reinterpret_cast<const uv_handle_t *>(&core->async) || handle == reinterpret_cast<const uv_handle_t *>(&core->prepare) || handle == reinterpret_cast<const uv_handle_t *>(&core->check)) {
+        return true;
+    }
+
+    // 时间轮和调度器的 handle 的 data 指向自己
+    return (timers && handle->data == timers.get()) || (jobs && handle->data == jobs.get());
+}
+
+UVCLS_INLINE void Loop::postCallback(uv_async_t *handle) {
+    Loop &ref = *(static_cast<Loop *>(handle->data));
+    ref.counters.asyncs++;
+    ref.tasks.consume([](auto &task) { task(); });
+}
+
+UVCLS_INLINE void Loop::prepareCallback(uv_prepare_t *handle) {
+    Loop &ref = *(static_cast<Loop *>(handle->data));
+    ref.fresh = false;
+    ref.drain();
+    // 和 uv_run 计算 poll 超时的方法一样，NOWAIT 模式不会阻塞
+    ref.blocking = !ref.nowait && uv_backend_timeout(handle->loop) != 0;
+}
+
+UVCLS_INLINE void Loop::checkCallback(uv_check_t *handle) {
+    Loop &ref = *(static_cast<Loop *>(handle->data));
+    ref.fresh = false;
+    ref.drain();
+    ref.counters.iterations++;
+    ref.rounds++;
+    ref.heartbeat.beat.store(ref.rounds, std::memory_order_relaxed);
+
+    if (ref.blocking) {
+        ref.counters.wakeups++;
+    }
+}
+
+UVCLS_INLINE int Loop::execute(uv_run_mode mode) noexcept {
+    nowait = (mode == UV_RUN_NOWAIT);
+    heartbeat.running.store(true, std::memory_order_relaxed);
+    auto result = uv_run(loop.get(), mode);
+    heartbeat.running.store(false, std::memory_order_relaxed);
+    return result;
+}
+
+UVCLS_INLINE Loop::Time Loop::now() const noexcept {
+    return Time{uv_now(loop.get())};
+}
+
+UVCLS_INLINE Loop::HRTime Loop::hrnow() noexcept {
+    if (!fresh) {
+        hrtime = uv_hrtime();
+        fresh = true;
+    }
+
+    return HRTime{hrtime};
+}
+
+UVCLS_INLINE void Loop::updateTime() noexcept {
+    uv_update_time(loop.get());
+    fresh = false;
+}
+
+UVCLS_INLINE std::uint64_t Loop::iteration() const noexcept {
+    return rounds;
+}
+
+UVCLS_INLINE LoopMetrics Loop::metrics(bool reset) noexcept {
+    auto now = uv_hrtime();
+    auto sent = signals.load(std::memory_order_relaxed);
+    auto result = counters;
+    result.seconds = static_cast<double>(now - since) / 1e9;
+    result.signals = sent - signalled;
+
+    if (reset) {
+        counters = LoopMetrics{};
+        since = now;
+        signalled = sent;
+    }
+
+    return result;
+}
+
+UVCLS_INLINE void Loop::post(Task task) {
+    // 只有队列从空变成非空的生产者才需要唤醒 loop
+    if (tasks.push(std::move(task))) {
+        signals.fetch_add(1, std::memory_order_relaxed);
+        uv_async_send(&core->async);
+    }
+}
+
+UVCLS_INLINE void Loop::keepAlive(bool enable) noexcept {
+    if (enable) {
+        uv_ref(reinterpret_cast<uv_handle_t *>(&core->async));
+    } else {
+        uv_unref(reinterpret_cast<uv_handle_t *>(&core->async));
+    }
+}
+
+UVCLS_INLINE void Loop::defer(Task task) {
+    if (deferred.empty()) {
+        // 有任务时让 loop 保持存活，否则 close 回调中 defer 的任务可能没有机会执行
+        uv_ref(reinterpret_cast<uv_handle_t *>(&core->prepare));
+    }
+
+    deferred.push_back(std::move(task));
+}
+
+UVCLS_INLINE void Loop::drain() {
+    while (!deferred.empty()) {
+        draining.swap(deferred);
+
+        for (auto &task : draining) {
+            task();
+        }
+
+        draining.clear();
+    }
+
+    uv_unref(reinterpret_cast<uv_handle_t *>(&core->prepare));
+}
+
+UVCLS_INLINE uv_loop_t *Loop::raw() noexcept {
+    return loop.get();
+}
+
+UVCLS_INLINE void Loop::place() noexcept {
+    if (!placed) {
+        if (!where.cpus.empty() && !numa::pin(where.cpus)) {
+            publish(ErrorEvent{static_cast<int>(UV_EINVAL)});
+        }
+
+        where.cpu = numa::cpu();
+        where.node = numa::node(where.cpu);
+    }
+
+    auto self = std::this_thread::get_id();
+
+    // loop 可以换线程运行（例如先在主线程 run 1 次再交给工作线程），线程变了才重新记录
+    if (placed && self == runner) {
+        return;
+    }
+
+    placed = true;
+    runner = self;
+
+    // 运行之前创建的缓冲池，所有者是创建它的线程
+    if (pool) {
+        pool->bind();
+    }
+
+#ifdef __linux__
+    heartbeat.thread.store(::pthread_self(), std::memory_order_relaxed);
+    heartbeat.tid.store(static_cast<pid_t>(::syscall(SYS_gettid)), std::memory_order_relaxed);
+#endif
+}
+
+UVCLS_INLINE Placement Loop::placement() const {
+    return where;
+}
+
+UVCLS_INLINE BufferPool &Loop::buffers() {
+    if (!pool) {
+        // 没有绑定 CPU 时依靠 first-touch，不做 mbind
+        pool = std::make_unique<BufferPool>(where.cpus.empty() ? -1 : numa::node(numa::cpu()));
+    }
+
+    return *pool;
+}
+
+UVCLS_INLINE TimerWheel &Loop::wheel() {
+    if (!timers) {
+        timers = std::make_unique<TimerWheel>(loop.get());
+    }
+
+    return *timers;
+}
+
+UVCLS_INLINE void Loop::spawn(Scheduler::Job job, Priority priority) {
+    scheduler().spawn(std::move(job), priority);
+}
+
+UVCLS_INLINE Scheduler &Loop::scheduler() {
+    if (!jobs) {
+        jobs = std::make_unique<Scheduler>(loop.get());
+    }
+
+    return *jobs;
+}
+
+UVCLS_INLINE Watchdog &Loop::watchdog() {
+    if (!dog) {
+        dog = std::make_unique<Watchdog>(heartbeat);
+    }
+
+    return *dog;
+}
+
 UVCLS_INLINE Loop::Loop(std::unique_ptr<uv_loop_t, Deleter> ptr) noexcept
-    : loop{std::move(ptr)} {}
+    : loop{std::move(ptr)}, core{std::make_unique<internal::LoopCore>()} {
+    uv_async_init(loop.get(), &core->async, &postCallback);
+    uv_unref(reinterpret_cast<uv_handle_t *>(&core->async));
+    core->async.data = this;
+
+    uv_prepare_init(loop.get(), &core->prepare);
+    uv_prepare_start(&core->prepare, &prepareCallback);
+    uv_unref(reinterpret_cast<uv_handle_t *>(&core->prepare));
+    core->prepare.data = this;
+
+    uv_check_init(loop.get(), &core->check);
+    uv_check_start(&core->check, &checkCallback);
+    uv_unref(reinterpret_cast<uv_handle_t *>(&core->check));
+    core->check.data = this;
+    since = uv_hrtime();
+}
 
 UVCLS_INLINE Loop::~Loop() noexcept {
     if (loop) {
         close();
     }
+
+    if (!loop) {
+        return;
+    }
+
+    // 还有其他 handle 或者 req，close 没有关闭 uv_loop_t。loop 自己的 handle 照样关闭，然后和 uv_loop_t、
+    // 时间轮、调度器一起泄漏：它们还挂在 uv_loop_t 上，之后再运行 uv_loop_t 也不会访问已经释放的内存
+    if (dog) {
+        dog->stop();
+    }
+
+    for (auto handle : {reinterpret_cast<uv_handle_t *>(&core->async), reinterpret_cast<uv_handle_t *>(&core->prepare), reinterpret_cast<uv_handle_t *>(&core->check)}) {
+        handle->data = nullptr;
+
+        if (!uv_is_closing(handle)) {
+            uv_close(handle, nullptr);
+        }
+    }
+
+    if (timers) {
+        timers->close();
+        static_cast<void>(timers.release());
+    }
+
+    if (jobs) {
+        jobs->close();
+        static_cast<void>(jobs.release());
+    }
+
+    static_cast<void>(core.release());
+    static_cast<void>(loop.release());
 }
 
 }  // namespace uvcls
@@ -0,0 +1,107 @@
+#ifndef UVCLS_NUMA_INCLUDE_H
+#define UVCLS_NUMA_INCLUDE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "config.h"
+
+/*
+CPU 亲和性和 NUMA 节点。没有 libnuma 依赖：节点信息来自 /sys，内存绑定直接用 mbind 系统调用。
+单 socket 的机器上节点都是 0，代码路径一样会执行。
+*/
+
+namespace uvcls {
+
+// loop 所在的核和 NUMA 节点，-1 表示未知
+struct Placement {
+    int cpu{-1};
+    int node{-1};
+    std::vector<unsigned int> cpus{}; /*!< 绑定的 CPU 集合，空表示没有绑定 */
+};
+
+namespace numa {
+
+// cpu 所在的 NUMA 节点。/sys/devices/system/cpu/cpuN/ 下面有 1 个 nodeM 目录
+UVCLS_INLINE int node(int cpu) noexcept {
+#ifdef __linux__
+    if (cpu < 0) {
+        return -1;
+    }
+
+    auto path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    int result = 0;
+
+    if (auto dir = ::opendir(path.c_str()); dir) {
+        while (auto entry = ::readdir(dir)) {
+            if (std::string name{entry->d_name}; name.compare(0, 4, "node") == 0 && name.size() > 4) {
+                result = std::stoi(name.substr(4));
+                break;
+            }
+        }
+
+        ::closedir(dir);
+    }
+
+    return result;
+#else
+    return -1;
+#endif
+}
+
+// 当前线程正在运行的核
+UVCLS_INLINE int cpu() noexcept {
+#ifdef __linux__
+    return ::sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+// 把当前线程绑定到 cpus 上
+UVCLS_INLINE bool pin(const std::vector<unsigned int> &cpus) noexcept {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (auto cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+// 让 [addr, addr + len) 优先从 node 上分配。必须在第一次访问这段内存之前调用
+UVCLS_INLINE bool bind(void *addr, std::size_t len, int node) noexcept {
+#if defined(__linux__) && defined(SYS_mbind)
+    constexpr int MPOL_PREFERRED = 1;
+    constexpr auto BITS = sizeof(unsigned long) * 8;
+
+    if (node < 0 || static_cast<std::size_t>(node) >= BITS) {
+        return false;
+    }
+
+    unsigned long mask = 1UL << node;
+    return ::syscall(SYS_mbind, addr, len, MPOL_PREFERRED, &mask, BITS, 0) == 0;
+#else
+    return false;
+#endif
+}
+
+}  // namespace numa
+
+}  // namespace uvcls
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef UVCLS_POLL_INCLUDE_H
+#define UVCLS_POLL_INCLUDE_H
+
+#include <uv.h>
+
+#include <type_traits>
+
+#include "handle.hpp"
+#include "util.hpp"
+
+namespace uvcls {
+
+enum class UVPollEvent : std::underlying_type_t<uv_poll_event> {
+    READABLE = UV_READABLE,
+    WRITABLE = UV_WRITABLE,
+    DISCONNECT = UV_DISCONNECT,
+    PRIORITIZED = UV_PRIORITIZED
+};
+
+struct PollEvent {
+    Flags<UVPollEvent> flags; /*!< 就绪的事件 */
+};
+
+/*
+监听 1 个 socket 的可读、可写。libuv 不允许同 1 个 fd 上有 2 个 watcher，已经被 uv_tcp_t 使用的 socket
+需要先 dup 1 个 fd 再交给 PollHandle。PollHandle 关闭时不会关闭 fd。
+*/
+class PollHandle final : public Handle<PollHandle, uv_poll_t> {
+    static void startCallback(uv_poll_t *handle, int status, int events);
+
+   public:
+    using Event = UVPollEvent;
+
+    PollHandle(std::shared_ptr<Loop> ref, uv_os_sock_t sock);
+
+    bool init();
+
+    // 重复调用时替换监听的事件
+    void start(Flags<Event> flags);
+
+    void stop();
+
+   private:
+    uv_os_sock_t socket;
+};
+
+UVCLS_INLINE PollHandle::PollHandle(std::shared_ptr<Loop> ref, uv_os_sock_t sock)
+    : Handle{std::move(ref)}, socket{sock} {}
+
+UVCLS_INLINE void PollHandle::startCallback(uv_poll_t *handle, int status, int events) {
+    PollHandle &poll = *(static_cast<PollHandle *>(handle->data));
+
+    if (status) {
+        poll.publish(ErrorEvent{status});
+    } else {
+        poll.publish(PollEvent{static_cast<std::underlying_type_t<Event>>(events)});
+    }
+}
+
+UVCLS_INLINE bool PollHandle::init() {
+    return initialize(&uv_poll_init_socket, socket);
+}
+
+UVCLS_INLINE void PollHandle::start(Flags<Event> flags) {
+    invoke(&uv_poll_start, get(), flags, &startCallback);
+}
+
+UVCLS_INLINE void PollHandle::stop() {
+    invoke(&uv_poll_stop, get());
+}
+
+}  // namespace uvcls
+
+#endif
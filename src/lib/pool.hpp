@@ -0,0 +1,261 @@
+#ifndef UVCLS_POOL_INCLUDE_H
+#define UVCLS_POOL_INCLUDE_H
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+#include "numa.hpp"
+#include "queue.hpp"
+
+/*
+loop 的读缓冲池。固定大小的块按 chunk 用 mmap 申请：
+
+1. 绑定了 NUMA 节点时先 mbind 再访问，否则依靠 first-touch：chunk 在 loop 线程中申请并逐页写 1 次。
+2. 空闲块用单链表串起来，acquire/release 都是 O(1)。
+3. 其他线程 release 的块先放进 MPSCQueue，loop 线程在空闲链表用完时再取回来。
+4. 状态放在引用计数的 Arena 中，池本身和每个借出的块各持有 1 个引用。块的删除器直接指向 Arena，
+   池（或者 loop）先析构时，chunk 在最后 1 个块归还之后才 munmap。
+5. 池可能在 loop 线程之外创建，loop 开始运行时调用 bind 把 loop 线程设为所有者。
+6. Buffer 是带删除器的 unique_ptr，可以移动转换成 std::unique_ptr<char[]>。池中的块会复制 1 份，
+   需要零拷贝时直接使用 Buffer。
+*/
+
+namespace uvcls {
+
+class BufferPool final {
+    struct Block {
+        Block *next;
+    };
+
+    struct Chunk {
+        char *base;
+        std::size_t length;
+    };
+
+    struct Arena {
+        Arena(int node, std::size_t blockSize) noexcept;
+
+        ~Arena() noexcept;
+
+        bool grow();
+
+        char *acquire();
+
+        void release(char *data) noexcept;
+
+        // 最后 1 个引用释放时删除自己
+        void unref() noexcept;
+
+        std::vector<Chunk> chunks{};
+        Block *free{nullptr};
+        MPSCQueue<char *> remote{};
+        std::atomic<std::size_t> refs{1};
+        std::atomic<std::thread::id> owner;
+        std::size_t size;
+        int numaNode;
+    };
+
+   public:
+    // libuv 给 TCP 读建议的大小就是 64 KiB
+    static constexpr std::size_t BLOCK_SIZE = 65536;
+    static constexpr std::size_t CHUNK_BLOCKS = 16;
+
+    // unique_ptr 的删除器。arena 为空时是普通的 new char[]。
+    // 用 Deleter{} 值初始化，没有默认成员初始化器，否则在 BufferPool 定义完之前 Buffer 不能默认构造
+    struct Deleter {
+        Arena *arena;
+
+        void operator()(char *data) const noexcept {
+            arena ? arena->release(data) : delete[] data;
+        }
+    };
+
+    class Buffer final : public std::unique_ptr<char[], Deleter> {
+       public:
+        using std::unique_ptr<char[], Deleter>::unique_ptr;
+
+        Buffer() noexcept = default;
+
+        // 兼容 std::unique_ptr<char[]>：块要还给池，复制整块；new char[] 的直接转移
+        operator std::unique_ptr<char[]>() && {
+            auto arena = this->get_deleter().arena;
+
+            if (!arena) {
+                return std::unique_ptr<char[]>{this->release()};
+            }
+
+            std::unique_ptr<char[]> copy{new char[arena->size]};
+            std::memcpy(copy.get(), this->get(), arena->size);
+            this->reset();
+            return copy;
+        }
+    };
+
+    // node 小于 0 表示不绑定 NUMA 节点
+    explicit BufferPool(int node = -1, std::size_t size = BLOCK_SIZE);
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    ~BufferPool() noexcept;
+
+    // 把当前线程设为所有者，所有者 release 的块直接放回空闲链表
+    void bind() noexcept;
+
+    // 只能在 loop 线程调用。失败时返回 nullptr
+    char *acquire();
+
+    // 任意线程都可以调用
+    void release(char *data) noexcept;
+
+    // size 超过块大小时退化为 new char[]
+    Buffer allocate(std::size_t size);
+
+    // 遍历所有 chunk，只用于检查。释放 Buffer 不需要它，删除器中已经记录了来源
+    bool owns(const char *data) const noexcept;
+
+    std::size_t blockSize() const noexcept;
+
+    // 已经申请的块数（包括正在使用的）
+    std::size_t capacity() const noexcept;
+
+    int node() const noexcept;
+
+   private:
+    Arena *arena;
+};
+
+UVCLS_INLINE BufferPool::Arena::Arena(int node, std::size_t blockSize) noexcept
+    : owner{std::this_thread::get_id()}, size{blockSize}, numaNode{node} {}
+
+UVCLS_INLINE BufferPool::Arena::~Arena() noexcept {
+    for (auto &chunk : chunks) {
+        ::munmap(chunk.base, chunk.length);
+    }
+}
+
+UVCLS_INLINE bool BufferPool::Arena::grow() {
+    auto length = size * CHUNK_BLOCKS;
+    auto addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    auto base = static_cast<char *>(addr);
+    numa::bind(base, length, numaNode);
+
+    // first-touch：在当前（loop）线程中访问每 1 页，物理页会分配在当前节点
+    for (std::size_t offset = 0, page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)); offset < length; offset += page) {
+        base[offset] = 0;
+    }
+
+    for (auto pos = CHUNK_BLOCKS; pos > 0; --pos) {
+        auto block = reinterpret_cast<Block *>(base + (pos - 1) * size);
+        block->next = free;
+        free = block;
+    }
+
+    chunks.push_back(Chunk{base, length});
+    return true;
+}
+
+UVCLS_INLINE char *BufferPool::Arena::acquire() {
+    if (!free) {
+        remote.consume([this](char *data) {
+            auto block = reinterpret_cast<Block *>(data);
+            block->next = free;
+            free = block;
+        });
+    }
+
+    if (!free && !grow()) {
+        return nullptr;
+    }
+
+    auto block = free;
+    free = block->next;
+    refs.fetch_add(1, std::memory_order_relaxed);
+    return reinterpret_cast<char *>(block);
+}
+
+UVCLS_INLINE void BufferPool::Arena::release(char *data) noexcept {
+    if (std::this_thread::get_id() == owner.load(std::memory_order_relaxed)) {
+        auto block = reinterpret_cast<Block *>(data);
+        block->next = free;
+        free = block;
+    } else {
+        remote.push(data);
+    }
+
+    unref();
+}
+
+UVCLS_INLINE void BufferPool::Arena::unref() noexcept {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+UVCLS_INLINE BufferPool::BufferPool(int node, std::size_t blockSize)
+    : arena{new Arena{node, blockSize}} {}
+
+UVCLS_INLINE BufferPool::~BufferPool() noexcept {
+    arena->unref();
+}
+
+UVCLS_INLINE void BufferPool::bind() noexcept {
+    arena->owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+}
+
+UVCLS_INLINE char *BufferPool::acquire() {
+    return arena->acquire();
+}
+
+UVCLS_INLINE void BufferPool::release(char *data) noexcept {
+    arena->release(data);
+}
+
+UVCLS_INLINE BufferPool::Buffer BufferPool::allocate(std::size_t len) {
+    if (len <= arena->size) {
+        if (auto data = arena->acquire(); data) {
+            return Buffer{data, Deleter{arena}};
+        }
+    }
+
+    return Buffer{new char[len], Deleter{}};
+}
+
+UVCLS_INLINE bool BufferPool::owns(const char *data) const noexcept {
+    for (auto &chunk : arena->chunks) {
+        if (data >= chunk.base && data < chunk.base + chunk.length) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+UVCLS_INLINE std::size_t BufferPool::blockSize() const noexcept {
+    return arena->size;
+}
+
+UVCLS_INLINE std::size_t BufferPool::capacity() const noexcept {
+    return arena->chunks.size() * CHUNK_BLOCKS;
+}
+
+UVCLS_INLINE int BufferPool::node() const noexcept {
+    return arena->numaNode;
+}
+
+}  // namespace uvcls
+
+#endif
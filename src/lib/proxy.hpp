@@ -0,0 +1,454 @@
+#ifndef UVCLS_PROXY_INCLUDE_H
+#define UVCLS_PROXY_INCLUDE_H
+
+#include <uv.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+#include <unistd.h>
+
+#include "config.h"
+#include "emitter.hpp"
+#include "poll.hpp"
+#include "stream.hpp"
+
+/*
+把 src 读到的数据转发给 dst，只负责 1 个方向，双向代理创建 2 个 pipe。
+
+1. SPLICE（Linux）：src → 内核 pipe → dst 都用 splice，数据不经过用户空间。src、dst 各 dup 1 个 fd 交给
+   PollHandle，pipe 满或者 dst 返回 EAGAIN 时停止读 src，TCP 的接收窗口随之关闭；pipe 中的数据写完后再读。
+   src 不能同时调用 read，否则 libuv 会先把数据读走。fd 不支持 splice（EINVAL）时退回 COPY。
+   dst 的写队列中还有 write 的数据时，splice 会插到它们前面，所以只读不写，等写队列清空的 WriteEvent 再继续。
+2. COPY：DataEvent → write。dst 写队列超过 HIGH_WATERMARK 时 src->stop()，WriteEvent 降到 LOW_WATERMARK 以下再 read。
+3. src 读到 EOF 且数据全部交给 dst 之后，dst->shutdown() 并发布 PipeEndEvent，反方向的 pipe 不受影响。
+4. 转发期间 pipe 持有自己，结束、出错、src 或 dst 关闭、调用 close 之后释放。不会关闭 src 和 dst。
+5. close 之后 src 的读状态：COPY 时 src 保持在读（因为背压 stop 了的会重新 read），DataEvent 交给其他监听函数；
+   SPLICE 时 src 从来没有 read，close 之后也不读，需要继续使用 src 时由调用者 read。已经进入内核 pipe、
+   还没有写到 dst 的数据随 pipe 一起丢弃，所以 SPLICE 的 pipe 中途 close 之后不能再接着转发同 1 条流。
+*/
+
+namespace uvcls {
+
+enum class PipeMode : std::uint8_t {
+    SPLICE,
+    COPY
+};
+
+// src 读到 EOF，数据都已经交给 dst
+struct PipeEndEvent {
+    std::uint64_t bytes; /*!< 转发的字节数 */
+};
+
+template <typename S, typename D>
+class StreamPipe final : public Emitter<StreamPipe<S, D>>, public std::enable_shared_from_this<StreamPipe<S, D>> {
+   public:
+    // 内核 pipe 的容量，设置失败时使用系统默认值
+    static constexpr std::size_t PIPE_SIZE = 256 * 1024;
+    // 每次可读、可写事件最多转发的字节数，避免 1 个连接占住 loop
+    static constexpr std::size_t QUANTUM = 4 * PIPE_SIZE;
+    static constexpr std::size_t HIGH_WATERMARK = 1024 * 1024;
+    static constexpr std::size_t LOW_WATERMARK = 256 * 1024;
+
+    StreamPipe(std::shared_ptr<S> source, std::shared_ptr<D> sink);
+
+    StreamPipe(const StreamPipe &) = delete;
+    StreamPipe &operator=(const StreamPipe &) = delete;
+
+    ~StreamPipe() noexcept;
+
+    void start(PipeMode mode = PipeMode::SPLICE);
+
+    // 停止转发，释放 dup 的 fd 和内核 pipe。之后 src 的读状态见文件开头第 5 点
+    void close() noexcept;
+
+    PipeMode mode() const noexcept;
+
+    std::uint64_t bytes() const noexcept;
+
+    bool active() const noexcept;
+
+   private:
+    bool open();
+
+    void copy();
+
+    // 在 src、pipe、dst 之间搬运数据，直到 EAGAIN 或者用完 QUANTUM
+    void pump();
+
+    // 等待 dst 的写队列清空
+    void drain();
+
+    void finish();
+
+    void fail(int err);
+
+    // 关闭 PollHandle 和内核 pipe
+    void release() noexcept;
+
+    std::shared_ptr<PollHandle> watch(uv_os_fd_t fd);
+
+    std::shared_ptr<S> src;
+    std::shared_ptr<D> dst;
+    std::shared_ptr<StreamPipe> self{nullptr};
+    std::shared_ptr<PollHandle> reader{nullptr};
+    std::shared_ptr<PollHandle> writer{nullptr};
+    typename Emitter<S>::template Index<DataEvent> onData{};
+    typename Emitter<S>::template Index<EndEvent> onEnd{};
+    typename Emitter<S>::template Index<ErrorEvent> onReadError{};
+    typename Emitter<D>::template Index<WriteEvent> onWrite{};
+    typename Emitter<D>::template Index<ErrorEvent> onWriteError{};
+    int fds[2]{-1, -1};
+    std::size_t capacity{PIPE_SIZE};
+    std::size_t buffered{0};
+    std::uint64_t total{0};
+    PipeMode current{PipeMode::SPLICE};
+    bool running{false};
+    bool eof{false};
+    bool throttled{false};
+    bool draining{false};
+};
+
+// 创建并启动 1 个方向的转发
+template <typename S, typename D>
+std::shared_ptr<StreamPipe<S, D>> pipe(std::shared_ptr<S> src, std::shared_ptr<D> dst, PipeMode mode = PipeMode::SPLICE) {
+    auto result = std::make_shared<StreamPipe<S, D>>(std::move(src), std::move(dst));
+    result->start(mode);
+    return result;
+}
+
+template <typename S, typename D>
+StreamPipe<S, D>::StreamPipe(std::shared_ptr<S> source, std::shared_ptr<D> sink)
+    : src{std::move(source)}, dst{std::move(sink)} {}
+
+template <typename S, typename D>
+StreamPipe<S, D>::~StreamPipe() noexcept {
+    close();
+}
+
+template <typename S, typename D>
+void StreamPipe<S, D>::start(PipeMode mode) {
+    if (running) {
+        return;
+    }
+
+    running = true;
+    self = this->shared_from_this();
+
+    // src 或 dst 关闭时 pipe 也结束
+    auto closed = [wptr = this->weak_from_this()](const auto &, auto &) {
+        if (auto ptr = wptr.lock(); ptr) {
+            ptr->close();
+        }
+    };
+
+    src->template once<CloseEvent>(closed);
+    dst->template once<CloseEvent>(closed);
+
+    if (mode == PipeMode::SPLICE && open()) {
+        current = PipeMode::SPLICE;
+        pump();
+    } else {
+        copy();
+    }
+}
+
+template <typename S, typename D>
+void StreamPipe<S, D>::close() noexcept {
+    if (!running) {
+        return;
+    }
+
+    running = false;
+    release();
+
+    if (current == PipeMode::COPY) {
+        src->erase(onData);
+        src->erase(onEnd);
+        src->erase(onReadError);
+        dst->erase(onWrite);
+        dst->erase(onWriteError);
+
+        // 背压时 stop 了 src，恢复成 pipe 开始时的读状态
+        if (throttled) {
+            throttled = false;
+
+            if (!src->closing()) {
+                src->read();
+            }
+        }
+    }
+
+    // 最后释放自己，调用者可能没有持有 pipe
+    auto keep = std::move(self);
+}
+
+template <typename S, typename D>
+PipeMode StreamPipe<S, D>::mode() const noexcept {
+    return current;
+}
+
+template <typename S, typename D>
+std::uint64_t StreamPipe<S, D>::bytes() const noexcept {
+    return total;
+}
+
+template <typename S, typename D>
+bool StreamPipe<S, D>::active() const noexcept {
+    return running;
+}
+
+template <typename S, typename D>
+bool StreamPipe<S, D>::open() {
+#ifdef __linux__
+    uv_os_fd_t in, out;
+
+    if (uv_fileno(src->template get<uv_handle_t>(), &in) || uv_fileno(dst->template get<uv_handle_t>(), &out)) {
+        return false;
+    }
+
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+        fds[0] = fds[1] = -1;
+        return false;
+    }
+
+    if (auto size = ::fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(PIPE_SIZE)); size > 0) {
+        capacity = static_cast<std::size_t>(size);
+    } else if (size = ::fcntl(fds[1], F_GETPIPE_SZ); size > 0) {
+        capacity = static_cast<std::size_t>(size);
+    }
+
+    reader = watch(in);
+    writer = watch(out);
+
+    if (!reader || !writer) {
+        release();
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+template <typename S, typename D>
+std::shared_ptr<PollHandle> StreamPipe<S, D>::watch(uv_os_fd_t fd) {
+    auto copy = ::dup(fd);
+
+    if (copy < 0) {
+        return nullptr;
+    }
+
+    auto poll = src->loop().template resource<PollHandle>(copy);
+
+    if (!poll) {
+        ::close(copy);
+        return nullptr;
+    }
+
+    poll->template on<CloseEvent>([copy](const auto &, auto &) { ::close(copy); });
+    // EPOLLERR 时 libuv 停止 poll 并回调 UV_EBADF，真正的错误由 splice 返回
+    auto ready = [wptr = this->weak_from_this()](const auto &, auto &) {
+        if (auto ptr = wptr.lock(); ptr) {
+            ptr->pump();
+        }
+    };
+
+    poll->template on<PollEvent>(ready);
+    poll->template on<ErrorEvent>(ready);
+
+    return poll;
+}
+
+template <typename S, typename D>
+void StreamPipe<S, D>::copy() {
+    current = PipeMode::COPY;
+
+    onData = src->template on<DataEvent>([wptr = this->weak_from_this()](DataEvent &event, auto &source) {
+        if (auto ptr = wptr.lock(); ptr) {
+            ptr->total += event.length;
+            ptr->dst->write(std::move(event.data), static_cast<unsigned int>(event.length));
+
+            if (ptr->dst->writeQueueSize() > HIGH_WATERMARK) {
+                ptr->throttled = true;
+                source.stop();
+            }
+        }
+    });
+
+    onWrite = dst->template on<WriteEvent>([wptr = this->weak_from_this()](const auto &, auto &sink) {
+        if (auto ptr = wptr.lock(); ptr && ptr->throttled && sink.writeQueueSize() <= LOW_WATERMARK) {
+            ptr->throttled = false;
+            ptr->src->read();
+        }
+    });
+
+    onEnd = src->template on<EndEvent>([wptr = this->weak_from_this()](const auto &, auto &) {
+        if (auto ptr = wptr.lock(); ptr) {
+            ptr->finish();
+        }
+    });
+
+    auto failed = [wptr = this->weak_from_this()](const ErrorEvent &event, auto &) {
+        if (auto ptr = wptr.lock(); ptr) {
+            ptr->fail(event.code());
+        }
+    };
+
+    onReadError = src->template on<ErrorEvent>(failed);
+    onWriteError = dst->template on<ErrorEvent>(failed);
+    src->read();
+}
+
+template <typename S, typename D>
+void StreamPipe<S, D>::pump() {
+#ifdef __linux__
+    constexpr unsigned int FLAGS = SPLICE_F_NONBLOCK | SPLICE_F_MOVE;
+    uv_os_fd_t in, out;
+    std::size_t moved = 0;
+
+    if (!running || src->closing() || dst->closing()) {
+        return;
+    }
+
+    uv_fileno(src->template get<uv_handle_t>(), &in);
+    uv_fileno(dst->template get<uv_handle_t>(), &out);
+
+    // 写队列清空之前不写 dst
+    auto blocked = dst->writeQueueSize() > 0;
+
+    while (moved < QUANTUM) {
+        // 先清空 pipe，写不动时停下来等 dst 可写
+        while (buffered && !blocked) {
+            auto n = ::splice(fds[0], nullptr, out, nullptr, buffered, FLAGS);
+
+            if (n > 0) {
+                buffered -= static_cast<std::size_t>(n);
+                total += static_cast<std::uint64_t>(n);
+                moved += static_cast<std::size_t>(n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && errno == EAGAIN) {
+                break;
+            } else {
+                return fail(n < 0 ? ErrorEvent::translate(errno) : static_cast<int>(UV_EPIPE));
+            }
+        }
+
+        if (eof || buffered >= capacity) {
+            break;
+        }
+
+        auto n = ::splice(in, nullptr, fds[1], nullptr, capacity - buffered, FLAGS);
+
+        if (n > 0) {
+            buffered += static_cast<std::size_t>(n);
+        } else if (n == 0) {
+            eof = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN) {
+            break;
+        } else if (errno == EINVAL && !total && !buffered) {
+            // fd 不支持 splice，还没有转发过数据，可以安全地换成 COPY
+            release();
+            return copy();
+        } else {
+            return fail(ErrorEvent::translate(errno));
+        }
+    }
+
+    if (eof && !buffered) {
+        return finish();
+    }
+
+    // 额度用完时 fd 仍然就绪，poll 是水平触发的，下一轮还会回调
+    if (!eof && buffered < capacity) {
+        reader->start(PollHandle::Event::READABLE);
+    } else {
+        reader->stop();
+    }
+
+    if (buffered && !blocked) {
+        writer->start(PollHandle::Event::WRITABLE);
+    } else {
+        writer->stop();
+    }
+
+    if (buffered && blocked) {
+        drain();
+    }
+#endif
+}
+
+template <typename S, typename D>
+void StreamPipe<S, D>::drain() {
+    if (draining) {
+        return;
+    }
+
+    draining = true;
+
+    // 写失败时 libuv 也会清空写队列
+    auto ready = [wptr = this->weak_from_this()](const auto &, auto &sink) {
+        if (auto ptr = wptr.lock(); ptr && ptr->draining && !sink.writeQueueSize()) {
+            ptr->draining = false;
+            sink.erase(ptr->onWrite);
+            sink.erase(ptr->onWriteError);
+            ptr->pump();
+        }
+    };
+
+    onWrite = dst->template on<WriteEvent>(ready);
+    onWriteError = dst->template on<ErrorEvent>(ready);
+}
+
+template <typename S, typename D>
+void StreamPipe<S, D>::finish() {
+    auto done = PipeEndEvent{total};
+
+    if (!dst->closing()) {
+        dst->shutdown();
+    }
+
+    close();
+    this->publish(done);
+}
+
+template <typename S, typename D>
+void StreamPipe<S, D>::fail(int err) {
+    close();
+    this->publish(ErrorEvent{err});
+}
+
+template <typename S, typename D>
+void StreamPipe<S, D>::release() noexcept {
+    if (draining) {
+        draining = false;
+        dst->erase(onWrite);
+        dst->erase(onWriteError);
+    }
+
+    for (auto *poll : {&reader, &writer}) {
+        if (*poll) {
+            (*poll)->close();
+            *poll = nullptr;
+        }
+    }
+
+    for (auto &fd : fds) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+}
+
+}  // namespace uvcls
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef UVCLS_QUEUE_INCLUDE_H
+#define UVCLS_QUEUE_INCLUDE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "config.h"
+
+namespace uvcls {
+
+// 缓存行大小，用于避免 false sharing
+static constexpr std::size_t CACHE_LINE = 64;
+
+/*
+无锁的多生产者单消费者队列（MPSC）。
+
+生产者用 CAS 把节点压入 1 个栈，消费者用 exchange 一次取走整个栈再反转成 FIFO 顺序。
+所以消费者每次唤醒处理的是一整批任务，而不是 1 个。push 返回 true 表示队列从空变成非空，
+只有这个生产者需要唤醒消费者，后面的生产者不会再产生唤醒。
+*/
+template <typename T>
+class MPSCQueue final {
+    struct Node {
+        T value;
+        Node *next;
+    };
+
+   public:
+    MPSCQueue() = default;
+    MPSCQueue(const MPSCQueue &) = delete;
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+    ~MPSCQueue() noexcept {
+        consume([](auto &&) {});
+    }
+
+    // 线程安全。返回 true 表示入队之前队列为空
+    bool push(T value) {
+        auto node = new Node{std::move(value), head.load(std::memory_order_relaxed)};
+
+        while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+
+        return node->next == nullptr;
+    }
+
+    // 只能由消费者调用。按入队顺序处理当前的一整批，返回处理的个数
+    template <typename F>
+    std::size_t consume(F &&f) {
+        Node *node = head.exchange(nullptr, std::memory_order_acquire);
+        Node *prev = nullptr;
+        std::size_t count = 0;
+
+        while (node) {
+            auto next = node->next;
+            node->next = prev;
+            prev = node;
+            node = next;
+        }
+
+        while (prev) {
+            auto next = prev->next;
+            f(prev->value);
+            delete prev;
+            prev = next;
+            ++count;
+        }
+
+        return count;
+    }
+
+    bool empty() const noexcept {
+        return head.load(std::memory_order_relaxed) == nullptr;
+    }
+
+   private:
+    alignas(CACHE_LINE) std::atomic<Node *> head{nullptr};
+};
+
+/*
+有界的无锁单生产者单消费者队列（SPSC），容量向上取整为 2 的幂。
+
+head 只由消费者写，tail 只由生产者写，两者放在不同的缓存行上。双方各自缓存对方的下标，
+只有在缓存的下标显示队列满（或空）时才去读对方的缓存行。
+*/
+template <typename T>
+class SPSCQueue final {
+   public:
+    // 实际容量：size 向上取整到 2 的幂
+    static std::size_t round(std::size_t size) noexcept {
+        std::size_t capacity = 1;
+
+        while (capacity < size) {
+            capacity <<= 1;
+        }
+
+        return capacity;
+    }
+
+    explicit SPSCQueue(std::size_t size)
+        : mask{round(size) - 1}, slots{new T[mask + 1]} {}
+
+    SPSCQueue(const SPSCQueue &) = delete;
+    SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+    // 只能由生产者调用。队列满时返回 false，value 不会被移动
+    bool push(T &value) {
+        auto pos = tail.load(std::memory_order_relaxed);
+
+        if (pos - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+
+            if (pos - cachedHead > mask) {
+                return false;
+            }
+        }
+
+        slots[pos & mask] = std::move(value);
+        tail.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 只能由消费者调用。队列空时返回 false
+    bool pop(T &value) {
+        auto pos = head.load(std::memory_order_relaxed);
+
+        if (pos == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+
+            if (pos == cachedTail) {
+                return false;
+            }
+        }
+
+        value = std::move(slots[pos & mask]);
+        head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 两端都可以调用，得到的是近似值
+    std::size_t size() const noexcept {
+        // 先读 head 再读 tail，保证结果不会下溢
+        auto pos = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_acquire) - pos;
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    std::size_t capacity() const noexcept {
+        return mask + 1;
+    }
+
+   private:
+    // 消费者的缓存行
+    alignas(CACHE_LINE) std::atomic<std::size_t> head{0};
+    std::size_t cachedTail{0};
+    // 生产者的缓存行
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail{0};
+    std::size_t cachedHead{0};
+    // 只读的部分
+    alignas(CACHE_LINE) const std::size_t mask;
+    std::unique_ptr<T[]> slots;
+};
+
+}  // namespace uvcls
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef UVCLS_SAMPLER_INCLUDE_H
+#define UVCLS_SAMPLER_INCLUDE_H
+
+#include <uv.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "config.h"
+#include "emitter.hpp"
+#include "loop.hpp"
+#include "tcp.hpp"
+#include "timer.hpp"
+
+/*
+定期采样 loop 上全部 TCP 连接的 TCP_INFO，发布 RTT 的 p50/p99。
+
+1. 用 uv_walk 遍历 loop 上的 handle，只看 UV_TCP 类型，直接对 fd 调用 getsockopt，不需要找到封装的 TCPHandle。
+   监听的 socket 和没有建立完成的连接跳过。
+2. RTT 放进复用的 vector 中，用 nth_element 取分位数。vector 只在连接数超过历史最大值时扩容，
+   每次采样不申请内存。
+*/
+
+namespace uvcls {
+
+// 1 次采样的结果，connections 为 0 时分位数都是 0
+struct TCPSampleEvent {
+    std::size_t connections;       /*!< 采样到的连接数 */
+    std::chrono::microseconds p50; /*!< RTT 的中位数 */
+    std::chrono::microseconds p99; /*!< RTT 的 99 分位 */
+};
+
+class TCPSampler final : public Emitter<TCPSampler>, public std::enable_shared_from_this<TCPSampler> {
+    static void walkCallback(uv_handle_t *handle, void *arg);
+
+   public:
+    explicit TCPSampler(std::shared_ptr<Loop> ref);
+
+    // 每隔 interval 采样 1 次。定时器是 unref 的，不会让 loop 一直运行
+    void start(std::chrono::milliseconds interval);
+
+    void stop();
+
+    // 立即采样 1 次并发布 TCPSampleEvent
+    void sample();
+
+    // 最近 1 次采样的结果
+    TCPSampleEvent latest() const noexcept;
+
+   private:
+    std::shared_ptr<Loop> loop;
+    std::shared_ptr<TimerHandle> timer{nullptr};
+    std::vector<std::uint32_t> rtts{};
+    TCPSampleEvent last{0, std::chrono::microseconds{0}, std::chrono::microseconds{0}};
+};
+
+UVCLS_INLINE TCPSampler::TCPSampler(std::shared_ptr<Loop> ref)
+    : loop{std::move(ref)} {}
+
+UVCLS_INLINE void TCPSampler::walkCallback(uv_handle_t *handle, void *arg) {
+#ifdef __linux__
+    constexpr std::uint8_t ESTABLISHED = 1;
+    auto &rtts = *static_cast<std::vector<std::uint32_t> *>(arg);
+    uv_os_fd_t fd;
+
+    if (handle->type != UV_TCP || uv_is_closing(handle) || uv_fileno(handle, &fd) != 0) {
+        return;
+    }
+
+    if (internal::KernelTCPInfo info{}; internal::tcpInfo(fd, info) && info.state == ESTABLISHED) {
+        rtts.push_back(info.rtt);
+    }
+#endif
+}
+
+UVCLS_INLINE void TCPSampler::start(std::chrono::milliseconds interval) {
+    if (!timer) {
+        timer = loop->resource<TimerHandle>();
+
+        if (!timer) {
+            return;
+        }
+
+        timer->on<TimerEvent>([wptr = weak_from_this()](const auto &, auto &) {
+            if (auto ptr = wptr.lock(); ptr) {
+                ptr->sample();
+            }
+        });
+
+        uv_unref(timer->get<uv_handle_t>());
+    }
+
+    timer->start(TimerHandle::Time{interval.count()}, TimerHandle::Time{interval.count()});
+}
+
+UVCLS_INLINE void TCPSampler::stop() {
+    if (timer) {
+        timer->close();
+        timer = nullptr;
+    }
+}
+
+UVCLS_INLINE void TCPSampler::sample() {
+    rtts.clear();
+    uv_walk(loop->raw(), &walkCallback, &rtts);
+
+    last = TCPSampleEvent{rtts.size(), std::chrono::microseconds{0}, std::chrono::microseconds{0}};
+
+    if (!rtts.empty()) {
+        // 先取 p99，p50 只需要在它前面的部分中找
+        auto p99 = rtts.begin() + static_cast<std::ptrdiff_t>((rtts.size() - 1) * 99 / 100);
+        auto p50 = rtts.begin() + static_cast<std::ptrdiff_t>((rtts.size() - 1) / 2);
+        std::nth_element(rtts.begin(), p99, rtts.end());
+        std::nth_element(rtts.begin(), p50, p99);
+        last.p50 = std::chrono::microseconds{*p50};
+        last.p99 = std::chrono::microseconds{*p99};
+    }
+
+    publish(last);
+}
+
+UVCLS_INLINE TCPSampleEvent TCPSampler::latest() const noexcept {
+    return last;
+}
+
+}  // namespace uvcls
+
+#endif
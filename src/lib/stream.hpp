@@ -1,9 +1,22 @@
 #ifndef UVCLS_STREAM_INCLUDE_H
 #define UVCLS_STREAM_INCLUDE_H
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
 #include "uv.h"
 #include "config.h"
 #include "handle.hpp"
+#include "poll.hpp"
+#include "wheel.hpp"
 
 /*
 Stream 统一封装的流操作接口。不可以理解成是 TCP 继承了 Stream。而是 Stream 通过统一的操作，根据传入
@@ -11,6 +24,22 @@ Stream 统一封装的流操作接口。不可以理解成是 TCP 继承了 Stre
 
 1. Listen 的回调函数是 on_new_connection。在 on_new_connection 中创建新结构体 uv_tcp_t。用 uv_accept
 初始化这个 uv_tcp_t 继续在 loop 中运行。
+批量 accept 模式（batch）下，1 次可读事件中先 uv_accept 1 个，再直接对监听 fd 调用 accept4，最多 N 个，
+放进预先创建好的 handle 中，对每个 handle 执行 prototype，然后只发布 1 个 AcceptedEvent。
+2. 读预算：1 个 handle 在 1 轮中读到的字节数或者次数达到预算时，uv_read_stop（或者派生类的 divert）停止读，
+通过 Loop::defer 在这轮 poll 之后重新 uv_read_start，下一轮 poll 再继续读。避免 1 个连接占满整轮。
+3. 空闲、读、写超时放在 loop 的时间轮上。读写时只记录时间，不会重新调度定时器，定时器到期时
+再检查是否真的超时，没有超时就按最后 1 次活动的时间重新调度。所以超时的误差在 1 个超时周期以内。
+4. 接入控制（admission）：并发连接数或者 loop 延迟超过阈值时，PAUSE 直接不调用 uv_accept。回调之前 libuv 已经
+accept 了 1 个连接放在 accepted_fd 中，没有取走时 libuv 停止监听 fd，其余的连接留在内核的 accept 队列中。
+负载降下来（active 小于上限）之后再发布 ListenEvent，先交出的就是这个连接，accept 之后计入 active，所以不会超过上限；
+暂停期间它占用 1 个 fd，在 stats 的 held 中。RESET 则 accept 之后立即 RST。
+loop 延迟由时间轮上的 1 个探测定时器测量：每 lag 毫秒到期 1 次，实际执行时间比到期时间晚多少就是延迟。
+5. sendFile：文件直接用 sendfile 发到 socket，数据不经过用户态。socket 是非阻塞的，但是文件不在页缓存中时
+sendfile 要等磁盘读，libuv 的 sendfile 模拟实现还会 poll 等待 socket，所以每块都用 uv_fs_sendfile 交给线程池，
+完成之后再提交下 1 块，直到 EAGAIN，然后等待下一次可写。线程池默认只有 4 个线程，和其他文件操作共用。
+可写事件来自 dup 出来的 fd 上的 PollHandle。libuv 的写队列中还有数据时先等待，保证和 write 的顺序一致；
+设置了 TCP_NOTSENT_LOWAT 时，可写事件本身就按低水位触发。
 */
 
 namespace uvcls {
@@ -21,15 +50,89 @@ struct EndEvent {};
 
 struct ListenEvent {};
 
+// sendFile 的进度，每次 sendfile 成功之后发布
+struct SendFileProgressEvent {
+    uv_file file;
+    std::size_t sent;   /*!< 已经发送的字节数 */
+    std::size_t length; /*!< 总字节数 */
+};
+
+// 1 次 sendFile 全部发送完成
+struct SendFileEvent {
+    uv_file file;
+    std::size_t length;
+};
+
+// 监听的流的接入控制
+struct AdmissionPolicy {
+    enum class Action : std::uint8_t {
+        PAUSE, /*!< 暂停 accept，libuv 保留已经 accept 的 1 个连接，其余的在内核的 accept 队列中等待 */
+        RESET  /*!< accept 之后立即 RST */
+    };
+
+    std::size_t connections{0};       /*!< 最大并发连接数，0 表示不限制 */
+    std::chrono::milliseconds lag{0}; /*!< loop 延迟的阈值，0 表示不检查 */
+    Action action{Action::PAUSE};
+};
+
+// 设置接入控制之后开始计数
+struct AdmissionStats {
+    std::uint64_t accepted;        /*!< 接受的连接数 */
+    std::uint64_t shed;            /*!< RESET 掉的连接数 */
+    std::size_t active;            /*!< 还没有关闭的连接数 */
+    std::chrono::milliseconds lag; /*!< 最近 1 次测得的 loop 延迟 */
+    bool paused;                   /*!< 正在暂停 accept */
+    std::size_t held;              /*!< 暂停时 libuv 已经 accept、还没有交出的连接数（0 或 1），不在 active 中 */
+};
+
+// 批量 accept 的结果。handles 只在发布期间有效，需要保留的 handle 要复制 shared_ptr
+template <typename T>
+struct AcceptedEvent {
+    const std::shared_ptr<T> *handles;
+    std::size_t count;
+
+    const std::shared_ptr<T> *begin() const noexcept {
+        return handles;
+    }
+
+    const std::shared_ptr<T> *end() const noexcept {
+        return handles + count;
+    }
+
+    std::size_t size() const noexcept {
+        return count;
+    }
+};
+
 struct ShutdownEvent {};
 
 struct WriteEvent {};
 
+// 超时之后发布 1 次，下一次活动时重新开始计时
+struct TimeoutEvent {
+    enum class Type : std::uint8_t {
+        IDLE,  /*!< 没有读到数据，也没有写完数据 */
+        READ,  /*!< read() 之后没有读到数据 */
+        WRITE  /*!< 有未完成的写，但是没有写完任何 1 个 */
+    };
+
+    explicit TimeoutEvent(Type t) noexcept;
+
+    Type type;
+};
+
+// 每轮的读预算，0 表示不限制
+struct ReadBudget {
+    std::size_t bytes{0}; /*!< 每轮最多读的字节数（最后 1 次读可能超过） */
+    std::size_t reads{0}; /*!< 每轮最多发布的 DataEvent 个数 */
+};
+
 struct DataEvent {
-    explicit DataEvent(std::unique_ptr<char[]> buf, std::size_t len) noexcept;
+    explicit DataEvent(BufferPool::Buffer buf, std::size_t len, std::chrono::nanoseconds stamp = std::chrono::nanoseconds{0}) noexcept;
 
-    std::unique_ptr<char[]> data; /*!< A bunch of data read on the stream. */
-    std::size_t length;           /*!< The amount of data read on the stream. */
+    BufferPool::Buffer data;           /*!< A bunch of data read on the stream. */
+    std::size_t length;                /*!< The amount of data read on the stream. */
+    std::chrono::nanoseconds timestamp; /*!< 内核收到数据的时刻（CLOCK_REALTIME），没有打开接收时间戳时为 0 */
 };
 
 struct ConnectReq final : public Request<ConnectReq, uv_connect_t> {
@@ -47,6 +150,26 @@ struct ShutdownReq final : public Request<ShutdownReq, uv_shutdown_t> {
     void shutdown(uv_stream_t *handle);
 };
 
+// 在线程池中执行 1 次 sendfile。socket 和文件都 dup 1 份，请求完成之前关闭 handle 或者文件，worker 也不会用到被复用的 fd
+class SendFileReq final : public Request<SendFileReq, uv_fs_t> {
+    static void sendfileCallback(uv_fs_t *req);
+
+   public:
+    using Request::Request;
+
+    ~SendFileReq() noexcept;
+
+    void sendfile(uv_os_fd_t socket, uv_file file, std::int64_t offset, std::size_t length);
+
+    // 成功时发送的字节数
+    std::size_t sent() const noexcept;
+
+   private:
+    int out{-1};
+    int in{-1};
+    std::size_t result{0};
+};
+
 template <typename Deleter>
 class WriteReq final : public Request<WriteReq<Deleter>, uv_write_t> {
    public:
@@ -68,36 +191,120 @@ class WriteReq final : public Request<WriteReq<Deleter>, uv_write_t> {
     uv_buf_t buf;
 };
 
+namespace internal {
+
+// 流的 1 种超时，timeout 为 0 表示没有设置
+struct StreamDeadline {
+    WheelTimer timer{};
+    std::uint64_t timeout{0};
+    std::uint64_t last{0};
+};
+
+// 批量 accept 的状态，只有监听的 handle 才会创建
+template <typename T>
+struct AcceptBatch {
+    std::size_t size{0};
+    std::function<void(T &)> prototype{};
+    // 预先创建并 init 的 handle
+    std::vector<std::shared_ptr<T>> spare{};
+    // 本次接受的 handle，clear 之后保留容量
+    std::vector<std::shared_ptr<T>> accepted{};
+    bool refilling{false};
+};
+
+// 1 次 sendFile
+struct FileTransfer {
+    uv_file file;
+    std::int64_t offset;
+    std::size_t length;
+    std::size_t sent;
+};
+
+// sendFile 的状态。poll 监听 dup 出来的 fd，关闭 poll 之后再关闭这个 fd
+struct FileSender {
+    std::deque<FileTransfer> queue{};
+    std::shared_ptr<PollHandle> poll{nullptr};
+    bool waiting{false};
+    // 有 1 块正在线程池中发送
+    bool busy{false};
+};
+
+// 接入控制的状态
+struct Admission {
+    AdmissionPolicy policy{};
+    // 测量 loop 延迟的定时器，expected 是它应该执行的时刻
+    WheelTimer probe{};
+    std::uint64_t expected{0};
+    std::uint64_t lag{0};
+    std::uint64_t accepted{0};
+    std::uint64_t shed{0};
+    std::size_t active{0};
+    bool paused{false};
+};
+
+// 有 closeReset（TCP）的流可以用 RST 拒绝连接
+template <typename R, typename = void>
+struct Resettable : std::false_type {};
+
+template <typename R>
+struct Resettable<R, std::void_t<decltype(std::declval<R &>().closeReset())>> : std::true_type {};
+
+// accept 之后需要设置记录的选项的 handle
+template <typename R, typename = void>
+struct Attachable : std::false_type {};
+
+template <typename R>
+struct Attachable<R, std::void_t<decltype(std::declval<R &>().attached())>> : std::true_type {};
+
+// 自己读 fd 的 handle（TCPHandle 的接收时间戳），开始、停止读时先交给它
+template <typename R, typename = void>
+struct Divertible : std::false_type {};
+
+template <typename R>
+struct Divertible<R, std::void_t<decltype(std::declval<R &>().divert(true))>> : std::true_type {};
+
+}  // namespace internal
+
 template <typename T, typename U>
 class StreamHandle : public Handle<T, U> {
     static constexpr unsigned int DEFAULT_BACKLOG = 1024;
+    static constexpr std::size_t TIMEOUTS = 3;
+    // 每次 sendfile 的最大长度
+    static constexpr std::size_t SENDFILE_CHUNK = 256 * 1024;
 
     // 数据读取回调。供 uv_read_start 使用
     static void readCallback(uv_stream_t *handle, ssize_t nread, const uv_buf_t *buf) {
         T &ref = *(static_cast<T *>(handle->data));
         // data will be destroyed no matter of what the value of nread is
-        std::unique_ptr<char[]> data{buf->base};
+        BufferPool::Buffer data{buf->base, std::exchange(ref.allocated, BufferPool::Deleter{})};
 
         // nread == 0 is ignored (see http://docs.libuv.org/en/v1.x/stream.html)
         // equivalent to EAGAIN/EWOULDBLOCK, it shouldn't be treated as an error
         // for we don't have data to emit though, it's fine to suppress it
 
-        if (nread == UV_EOF) {
-            // end of stream
-            ref.publish(EndEvent{});
-        } else if (nread > 0) {
-            // data available
-            ref.publish(DataEvent{std::move(data), static_cast<std::size_t>(nread)});
-        } else if (nread < 0) {
-            // transmission error
-            ref.publish(ErrorEvent(nread));
+        if (nread > 0) {
+            ref.consume(static_cast<std::size_t>(nread));
         }
+
+        ref.received(nread, std::move(data), std::chrono::nanoseconds{0});
+    }
+
+    // 读缓冲从 loop 的缓冲池中分配。libuv 每次 alloc 之后紧接着 1 次 read 回调，删除器先记在 allocated 中
+    static void allocCallback(uv_handle_t *handle, std::size_t suggested, uv_buf_t *buf) {
+        T &ref = *(static_cast<T *>(handle->data));
+        auto data = ref.loop().buffers().allocate(suggested);
+        ref.allocated = data.get_deleter();
+        *buf = uv_buf_init(data.release(), static_cast<unsigned int>(suggested));
     }
 
     // fd 监听成功回调。供 uv_listen 使用
     static void listenCallback(uv_stream_t *handle, int status) {
         if (T &ref = *(static_cast<T *>(handle->data)); status) {
             ref.publish(ErrorEvent{status});
+        } else if (ref.control && ref.overloaded()) {
+            ref.refuse();
+        } else if (ref.batching && ref.batching->size) {
+            ref.drain();
         } else {
             ref.publish(ListenEvent{});
         }
@@ -107,11 +314,44 @@ class StreamHandle : public Handle<T, U> {
     using Handle<T, U>::Handle;
     using NullDeleter = void (*)(char *);
 
+    // Handle::close 调用：关闭之前先取消超时。派生类的 dispose 要调用它
+    void dispose() noexcept {
+        cancel();
+    }
+
+    // 设置 1 种超时，0 表示取消。超时之后发布 TimeoutEvent
+    void timeout(TimeoutEvent::Type type, std::chrono::milliseconds time) {
+        if (!deadlines) {
+            if (!time.count()) {
+                return;
+            }
+
+            deadlines = std::make_unique<internal::StreamDeadline[]>(TIMEOUTS);
+        }
+
+        auto &deadline = deadlines[static_cast<std::size_t>(type)];
+        auto &wheel = this->loop().wheel();
+        deadline.timeout = static_cast<std::uint64_t>(time.count());
+        deadline.last = this->loop().now().count();
+        deadline.timer.on([this, type]() { expire(type); });
+        // 超时本身是近似的，允许推迟 1/16，让同一时段的连接共用 1 次唤醒
+        deadline.timer.slack(deadline.timeout >> 4);
+
+        if (!deadline.timeout) {
+            wheel.cancel(deadline.timer);
+        } else if (active(type)) {
+            wheel.schedule(deadline.timer, deadline.timeout);
+        }
+    }
+
+    std::chrono::milliseconds timeout(TimeoutEvent::Type type) const noexcept {
+        return std::chrono::milliseconds{deadlines ? deadlines[static_cast<std::size_t>(type)].timeout : 0};
+    }
+
     void shutdown() {
         auto listener = [ptr = this->shared_from_this()](const auto &event, const auto &) {
             ptr->publish(event);
         };
-        auto req = std::make_shared<ShutdownReq>(this->loop().shared_from_this());
         auto shutdown = this->loop().template resource<ShutdownReq>();
         shutdown->template once<ErrorEvent>(listener);
         shutdown->template once<ShutdownEvent>(listener);
@@ -122,17 +362,109 @@ class StreamHandle : public Handle<T, U> {
         this->invoke(&uv_listen, this->template get<uv_stream_t>(), backlog, &listenCallback);
     }
 
+    // 开启批量 accept：每次可读事件最多接受 size 个连接，发布 AcceptedEvent<T> 代替 ListenEvent。
+    // prototype 在发布之前对每个新 handle 执行 1 次，用于注册监听函数、设置选项。size 为 0 时关闭
+    void batch(std::size_t size, std::function<void(T &)> prototype = nullptr) {
+        if (!batching) {
+            batching = std::make_unique<internal::AcceptBatch<T>>();
+        }
+
+        batching->size = size;
+        batching->prototype = std::move(prototype);
+        refill();
+    }
+
+    // 设置接入控制。listen 之前或者之后都可以设置，默认值表示关闭
+    void admission(AdmissionPolicy policy) {
+        if (!control) {
+            control = std::make_unique<internal::Admission>();
+            control->probe.on([this]() { measure(); });
+        }
+
+        control->policy = policy;
+        control->lag = 0;
+
+        if (policy.lag.count()) {
+            control->expected = this->loop().now().count() + static_cast<std::uint64_t>(policy.lag.count());
+            this->loop().wheel().schedule(control->probe, static_cast<std::uint64_t>(policy.lag.count()));
+        } else {
+            this->loop().wheel().cancel(control->probe);
+        }
+
+        resume();
+    }
+
+    AdmissionPolicy admission() const noexcept {
+        return control ? control->policy : AdmissionPolicy{};
+    }
+
+    AdmissionStats stats() const noexcept {
+        if (!control) {
+            return AdmissionStats{0, 0, 0, std::chrono::milliseconds{0}, false, 0};
+        }
+
+#ifndef _WIN32
+        std::size_t held = this->template get<uv_stream_t>()->accepted_fd != -1;
+#else
+        std::size_t held = 0;
+#endif
+
+        return AdmissionStats{control->accepted, control->shed, control->active, std::chrono::milliseconds{control->lag}, control->paused, held};
+    }
+
     // 获取底层 this->template get<uv_stream_t>() 的底层 uv_stream_t
     template <typename S>
     void accept(S &ref) {
         auto serverTcp = this->template get<uv_stream_t>();
         auto clientTcp = this->template get<uv_stream_t>(ref);
-        this->invoke(&uv_accept, serverTcp, clientTcp);
+
+        if (auto err = uv_accept(serverTcp, clientTcp); err) {
+            this->publish(ErrorEvent{err});
+        } else {
+            if constexpr (internal::Attachable<S>::value) {
+                ref.attached();
+            }
+
+            admit(ref);
+        }
     }
 
     // 当前的连接已经 accpet 之后。执行 uv_read_start, 新的 fd 的 io watcher 开始监听
     void read() {
-        this->invoke(&uv_read_start, this->template get<uv_stream_t>(), &this->allocCallback, &readCallback);
+        reading = true;
+        throttled = false;
+        touch(TimeoutEvent::Type::READ);
+        startRead();
+    }
+
+    // 停止读，之后不会因为读预算自动恢复
+    void stop() {
+        reading = false;
+        throttled = false;
+        stopRead();
+    }
+
+    // 把文件 [offset, offset + length) 发送到流上，多次调用时按顺序发送。文件在 SendFileEvent 之前不能关闭
+    void sendFile(uv_file file, std::int64_t offset, std::size_t length) {
+        if (!sender) {
+            sender = std::make_unique<internal::FileSender>();
+        }
+
+        submit();
+        sender->queue.push_back(internal::FileTransfer{file, offset, length, 0});
+
+        if (sender->queue.size() == 1 && !sender->waiting) {
+            transmit();
+        }
+    }
+
+    // 设置每轮的读预算
+    void budget(ReadBudget value) noexcept {
+        limit = value;
+    }
+
+    ReadBudget budget() const noexcept {
+        return limit;
     }
 
     // write 时，即时创建 1 个 WriteReq对象。
@@ -140,9 +472,11 @@ class StreamHandle : public Handle<T, U> {
     void write(std::unique_ptr<char[], Deleter> data, unsigned int len) {
         auto req = std::make_shared<WriteReq<Deleter>>(this->loop().shared_from_this(), std::move(data), len);
         auto listener = [ptr = this->shared_from_this()](const auto &event, const auto &) {
+            ptr->written();
             ptr->publish(event);
         };
 
+        submit();
         req->template once<ErrorEvent>(listener);
         req->template once<WriteEvent>(listener);
         req->write(this->template get<uv_stream_t>());
@@ -153,8 +487,10 @@ class StreamHandle : public Handle<T, U> {
         auto reqData  = std::unique_ptr<char[], NullDeleter>{data, [](char*) {}};
         auto req = std::make_shared<WriteReq<NullDeleter>>(this->loop().shared_from_this(), std::move(reqData), len);
         auto listener = [ptr = this->shared_from_this()](const auto &event, const auto &) {
+            ptr->written();
             ptr->publish(event);
         };
+        submit();
         req->template once<ErrorEvent>(listener);
         req->template once<WriteEvent>(listener);
         req->write(this->template get<uv_stream_t>());
@@ -165,9 +501,11 @@ class StreamHandle : public Handle<T, U> {
     void write(S &send, std::unique_ptr<char[], Deleter> data, unsigned int len) {
         auto req = std::make_shared<WriteReq<Deleter>>(this->loop().shared_from_this(), std::move(data), len);
         auto listener = [ptr = this->shared_from_this()](const auto &event, const auto &) {
+            ptr->written();
             ptr->publish(event);
         };
 
+        submit();
         req->template once<ErrorEvent>(listener);
         req->template once<WriteEvent>(listener);
         req->write(this->template get<uv_stream_t>(), this->template get<uv_stream_t>(send));
@@ -179,9 +517,11 @@ class StreamHandle : public Handle<T, U> {
         auto reqData = std::unique_ptr<char[], NullDeleter>{data, [](char*) {}};
         auto req = std::make_shared<WriteReq<NullDeleter>>(this->loop().shared_from_this(), std::move(data), len);
         auto listener = [ptr = this->shared_from_this()](const auto &event, const auto &) {
+            ptr->written();
             ptr->publish(event);
         };
 
+        submit();
         req->template once<ErrorEvent>(listener);
         req->template once<WriteEvent>(listener);
         req->write(this->template get<uv_stream_t>(), this->template get<uv_stream_t>(send));
@@ -252,15 +592,511 @@ class StreamHandle : public Handle<T, U> {
     size_t writeQueueSize() const noexcept {
         return uv_stream_get_write_queue_size(this->template get<uv_stream_t>());
     }
+
+   protected:
+    // 提交和完成 1 次写，用于写超时。子类自己实现的写路径也要调用
+    void submit() {
+        if (writing++ == 0) {
+            touch(TimeoutEvent::Type::WRITE);
+        }
+    }
+
+    void written() {
+        writing--;
+        touch(TimeoutEvent::Type::WRITE);
+        touch(TimeoutEvent::Type::IDLE);
+    }
+
+    // 读到数据、EOF 或者错误。派生类不经过 uv_read_start 自己读 fd 时（TCPHandle 的接收时间戳）也用它发布
+    void received(ssize_t nread, BufferPool::Buffer data, std::chrono::nanoseconds stamp) {
+        if (nread == UV_EOF) {
+            // end of stream
+            reading = false;
+            this->publish(EndEvent{});
+        } else if (nread > 0) {
+            // data available
+            touch(TimeoutEvent::Type::READ);
+            touch(TimeoutEvent::Type::IDLE);
+            this->publish(DataEvent{std::move(data), static_cast<std::size_t>(nread), stamp});
+        } else if (nread < 0) {
+            // transmission error
+            reading = false;
+            this->publish(ErrorEvent(nread));
+        }
+    }
+
+    // 记录本轮读到的数据，达到预算时停止读，这轮 poll 之后恢复。派生类自己读 fd 时每次读完也要调用
+    void consume(std::size_t len) {
+        if (!limit.bytes && !limit.reads) {
+            return;
+        }
+
+        if (auto now = this->loop().iteration(); epoch != now) {
+            epoch = now;
+            spentBytes = 0;
+            spentReads = 0;
+        }
+
+        spentBytes += len;
+        spentReads++;
+
+        if ((limit.bytes && spentBytes >= limit.bytes) || (limit.reads && spentReads >= limit.reads)) {
+            stopRead();
+            throttled = true;
+
+            this->loop().defer([ptr = this->shared_from_this()]() {
+                if (ptr->throttled && !ptr->closing()) {
+                    ptr->throttled = false;
+                    ptr->startRead();
+                }
+            });
+        }
+    }
+
+    // 取消全部超时，关闭预先创建的 handle，关闭 handle 时调用
+    void cancel() noexcept {
+        if (deadlines) {
+            for (std::size_t type = 0; type < TIMEOUTS; ++type) {
+                this->loop().wheel().cancel(deadlines[type].timer);
+            }
+        }
+
+        if (batching) {
+            for (auto &spare : batching->spare) {
+                spare->close();
+            }
+
+            batching->spare.clear();
+            batching->size = 0;
+        }
+
+        if (control) {
+            this->loop().wheel().cancel(control->probe);
+        }
+
+        if (sender) {
+            sender->queue.clear();
+
+            if (sender->poll) {
+                sender->poll->close();
+                sender->poll = nullptr;
+            }
+        }
+    }
+
+   private:
+    // 发送队列中的文件，每次提交 1 块给线程池，完成之后在 transmitted 中继续
+    void transmit() {
+        auto &state = *sender;
+        uv_os_fd_t fd;
+        state.waiting = false;
+
+        if (state.busy || this->closing() || uv_fileno(this->template get<uv_handle_t>(), &fd)) {
+            return;
+        }
+
+        while (!state.queue.empty() && !this->closing()) {
+            auto &job = state.queue.front();
+
+            if (job.sent == job.length) {
+                auto done = SendFileEvent{job.file, job.length};
+                state.queue.pop_front();
+                written();
+                this->publish(done);
+                continue;
+            }
+
+            // libuv 的写队列清空之后再发送
+            if (this->template get<uv_stream_t>()->write_queue_size) {
+                break;
+            }
+
+            auto req = this->loop().template resource<SendFileReq>();
+            auto chunk = std::min(job.length - job.sent, SENDFILE_CHUNK);
+            auto offset = job.offset + static_cast<std::int64_t>(job.sent);
+
+            req->template once<ErrorEvent>([wptr = this->weak_from_this()](const auto &event, auto &) {
+                if (auto ptr = wptr.lock(); ptr) {
+                    ptr->transmitted(event.code());
+                }
+            });
+            req->template once<WriteEvent>([wptr = this->weak_from_this()](const auto &, auto &ref) {
+                if (auto ptr = wptr.lock(); ptr) {
+                    // 0 表示文件比 length 短
+                    ref.sent() ? ptr->transmitted(static_cast<ssize_t>(ref.sent())) : ptr->transmitted(UV_EOF);
+                }
+            });
+
+            state.busy = true;
+            req->sendfile(fd, job.file, offset, chunk);
+            return;
+        }
+
+        if (!this->closing() && !state.queue.empty()) {
+            wait(fd);
+        } else if (state.poll) {
+            state.poll->stop();
+        }
+    }
+
+    // 1 块 sendfile 完成，result 是发送的字节数或者错误码
+    void transmitted(ssize_t result) {
+        auto &state = *sender;
+        uv_os_fd_t fd;
+        state.busy = false;
+
+        // close 已经清空了队列
+        if (this->closing() || state.queue.empty()) {
+            return;
+        }
+
+        if (result == UV_EAGAIN) {
+            if (!uv_fileno(this->template get<uv_handle_t>(), &fd)) {
+                wait(fd);
+            }
+
+            return;
+        }
+
+        if (auto &job = state.queue.front(); result < 0) {
+            state.queue.pop_front();
+            written();
+            this->publish(ErrorEvent{static_cast<int>(result)});
+        } else {
+            job.sent += static_cast<std::size_t>(result);
+            touch(TimeoutEvent::Type::WRITE);
+            touch(TimeoutEvent::Type::IDLE);
+            this->publish(SendFileProgressEvent{job.file, job.sent, job.length});
+        }
+
+        transmit();
+    }
+
+    // 等待 socket 可写
+    void wait(uv_os_fd_t fd) {
+        auto &state = *sender;
+
+        if (!state.poll) {
+            auto copy = ::dup(fd);
+
+            if (copy < 0) {
+                this->publish(ErrorEvent{ErrorEvent::translate(errno)});
+                return;
+            }
+
+            if (state.poll = this->loop().template resource<PollHandle>(copy); !state.poll) {
+                ::close(copy);
+                return;
+            }
+
+            state.poll->template on<CloseEvent>([copy](const auto &, auto &) { ::close(copy); });
+            state.poll->template on<PollEvent>([wptr = this->weak_from_this()](const auto &, auto &) {
+                if (auto ptr = wptr.lock(); ptr) {
+                    ptr->transmit();
+                }
+            });
+        }
+
+        state.waiting = true;
+        state.poll->start(PollHandle::Event::WRITABLE);
+    }
+
+    bool overloaded() const noexcept {
+        auto &state = *control;
+        auto lag = static_cast<std::uint64_t>(state.policy.lag.count());
+        return (state.policy.connections && state.active >= state.policy.connections) || (lag && state.lag >= lag);
+    }
+
+    // 记录接受的连接，连接关闭时减少计数
+    template <typename S>
+    void admit(S &ref) {
+        if (control) {
+            control->accepted++;
+            control->active++;
+
+            ref.template once<CloseEvent>([server = this->weak_from_this()](const auto &, auto &) {
+                if (auto ptr = server.lock(); ptr && ptr->control) {
+                    ptr->control->active--;
+                    ptr->resume();
+                }
+            });
+        }
+    }
+
+    void refuse() {
+        auto &state = *control;
+
+        // 回调中没有 accept，libuv 保留 accepted_fd 中的连接并停止监听 fd，直到下一次 uv_accept
+        if (state.policy.action == AdmissionPolicy::Action::PAUSE) {
+            state.paused = true;
+            return;
+        }
+
+        auto handle = this->loop().template resource<T>();
+
+        if (!handle) {
+            state.paused = true;
+            return;
+        }
+
+        if (uv_accept(this->template get<uv_stream_t>(), this->template get<uv_stream_t>(*handle))) {
+            handle->close();
+            return;
+        }
+
+        state.shed++;
+
+        if constexpr (internal::Resettable<T>::value) {
+            handle->closeReset();
+        } else {
+            handle->close();
+        }
+    }
+
+    // 负载降下来之后恢复 accept，暂停时留下的连接在 accepted_fd 中，重新发布 1 次即可。这时 active 小于上限，
+    // 它被 accept 之后才计入 active
+    void resume() {
+        if (control->paused && !overloaded()) {
+            control->paused = false;
+
+            this->loop().defer([ptr = this->shared_from_this()]() {
+                if (ptr->closing() || ptr->control->paused) {
+                    return;
+                }
+
+                listenCallback(ptr->template get<uv_stream_t>(), 0);
+            });
+        }
+    }
+
+    void measure() {
+        auto &state = *control;
+        auto now = this->loop().now().count();
+        auto interval = static_cast<std::uint64_t>(state.policy.lag.count());
+        state.lag = now > state.expected ? now - state.expected : 0;
+        state.expected = now + interval;
+        this->loop().wheel().schedule(state.probe, interval);
+        resume();
+    }
+
+    std::shared_ptr<T> take() {
+        if (batching->spare.empty()) {
+            return this->loop().template resource<T>();
+        }
+
+        auto handle = std::move(batching->spare.back());
+        batching->spare.pop_back();
+        return handle;
+    }
+
+    // 在 defer 中补齐预先创建的 handle，不占用 accept 的时间
+    void refill() {
+        if (!batching->refilling) {
+            batching->refilling = true;
+
+            this->loop().defer([ptr = this->shared_from_this()]() {
+                auto &state = *ptr->batching;
+                state.refilling = false;
+
+                while (!ptr->closing() && state.spare.size() < state.size) {
+                    if (auto handle = ptr->loop().template resource<T>(); handle) {
+                        state.spare.push_back(std::move(handle));
+                    } else {
+                        break;
+                    }
+                }
+            });
+        }
+    }
+
+    void drain() {
+        auto &state = *batching;
+        auto server = this->template get<uv_stream_t>();
+        auto limit = state.size;
+
+        // 不能超过接入控制剩余的连接数
+        if (control && control->policy.connections) {
+            limit = std::min(limit, control->policy.connections - control->active);
+        }
+
+        if (auto handle = take(); !handle) {
+            return;
+        } else if (auto err = uv_accept(server, this->template get<uv_stream_t>(*handle)); err) {
+            handle->close();
+            this->publish(ErrorEvent{err});
+            return;
+        } else {
+            if constexpr (internal::Attachable<T>::value) {
+                handle->attached();
+            }
+
+            state.accepted.push_back(std::move(handle));
+        }
+
+        uv_os_fd_t fd;
+        uv_fileno(this->template get<uv_handle_t>(), &fd);
+
+        // 剩下的直接 accept，EAGAIN 说明已经取完。出错时留给 libuv 在下一次 accept 时报告
+        while (state.accepted.size() < limit) {
+#ifdef __linux__
+            auto sock = ::accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+            auto sock = ::accept(fd, nullptr, nullptr);
+#endif
+
+            if (sock < 0) {
+                break;
+            }
+
+            auto handle = take();
+
+            if (!handle) {
+                ::close(sock);
+                break;
+            }
+
+            // open 失败时 handle 上没有 fd，handle 放回去下次再用
+            if (uv_os_fd_t opened; handle->open(sock), uv_fileno(this->template get<uv_handle_t>(*handle), &opened)) {
+                ::close(sock);
+                state.spare.push_back(std::move(handle));
+            } else {
+                state.accepted.push_back(std::move(handle));
+            }
+        }
+
+        for (auto &handle : state.accepted) {
+            admit(*handle);
+
+            if (state.prototype) {
+                state.prototype(*handle);
+            }
+        }
+
+        this->publish(AcceptedEvent<T>{state.accepted.data(), state.accepted.size()});
+        state.accepted.clear();
+        refill();
+    }
+
+    bool active(TimeoutEvent::Type type) const noexcept {
+        switch (type) {
+            case TimeoutEvent::Type::READ:
+                return reading;
+            case TimeoutEvent::Type::WRITE:
+                return writing > 0;
+            default:
+                return true;
+        }
+    }
+
+    // 记录活动时间。只有定时器没有在时间轮上时才调度
+    void touch(TimeoutEvent::Type type) {
+        if (deadlines) {
+            if (auto &deadline = deadlines[static_cast<std::size_t>(type)]; deadline.timeout) {
+                deadline.last = this->loop().now().count();
+
+                if (!deadline.timer.pending() && active(type)) {
+                    this->loop().wheel().schedule(deadline.timer, deadline.timeout);
+                }
+            }
+        }
+    }
+
+    void expire(TimeoutEvent::Type type) {
+        auto &deadline = deadlines[static_cast<std::size_t>(type)];
+        auto now = this->loop().now().count();
+
+        if (this->closing() || !active(type)) {
+            // 不再计时，下一次活动时由 touch 重新调度
+        } else if (auto expires = deadline.last + deadline.timeout; now < expires) {
+            this->loop().wheel().schedule(deadline.timer, expires - now);
+        } else {
+            this->publish(TimeoutEvent{type});
+        }
+    }
+
+    // 开始、停止读 fd。派生类的 divert 返回 true 时由它自己读，通过 StreamHandle 的引用调用也会分发到它
+    void startRead() {
+        if constexpr (internal::Divertible<T>::value) {
+            if (static_cast<T &>(*this).divert(true)) {
+                return;
+            }
+        }
+
+        this->invoke(&uv_read_start, this->template get<uv_stream_t>(), &allocCallback, &readCallback);
+    }
+
+    void stopRead() {
+        if constexpr (internal::Divertible<T>::value) {
+            if (static_cast<T &>(*this).divert(false)) {
+                return;
+            }
+        }
+
+        this->invoke(&uv_read_stop, this->template get<uv_stream_t>());
+    }
+
+    std::unique_ptr<internal::StreamDeadline[]> deadlines{nullptr};
+    std::size_t writing{0};
+    bool reading{false};
+    // 读预算和本轮（epoch）已经用掉的部分
+    ReadBudget limit{};
+    std::uint64_t epoch{0};
+    std::size_t spentBytes{0};
+    std::size_t spentReads{0};
+    bool throttled{false};
+    std::unique_ptr<internal::AcceptBatch<T>> batching{nullptr};
+    std::unique_ptr<internal::Admission> control{nullptr};
+    std::unique_ptr<internal::FileSender> sender{nullptr};
+    // 上一次 allocCallback 分配的读缓冲的删除器，readCallback 中取走
+    BufferPool::Deleter allocated{};
 };
 
-UVCLS_INLINE DataEvent::DataEvent(std::unique_ptr<char[]> buf, std::size_t len) noexcept
-    : data{std::move(buf)}, length{len} {}
+UVCLS_INLINE DataEvent::DataEvent(BufferPool::Buffer buf, std::size_t len, std::chrono::nanoseconds stamp) noexcept
+    : data{std::move(buf)}, length{len}, timestamp{stamp} {}
+
+UVCLS_INLINE TimeoutEvent::TimeoutEvent(Type t) noexcept
+    : type{t} {}
 
 UVCLS_INLINE void ShutdownReq::shutdown(uv_stream_t *handle) {
     invoke(&uv_shutdown, get(), handle, &defaultCallback<ShutdownEvent>);
 }
 
+UVCLS_INLINE void SendFileReq::sendfileCallback(uv_fs_t *req) {
+    auto ptr = reserve(req);
+    auto result = req->result;
+    uv_fs_req_cleanup(req);
+
+    if (result < 0) {
+        ptr->publish(ErrorEvent{static_cast<int>(result)});
+    } else {
+        ptr->result = static_cast<std::size_t>(result);
+        ptr->publish(WriteEvent{});
+    }
+}
+
+UVCLS_INLINE SendFileReq::~SendFileReq() noexcept {
+    if (out >= 0) {
+        ::close(out);
+    }
+
+    if (in >= 0) {
+        ::close(in);
+    }
+}
+
+UVCLS_INLINE void SendFileReq::sendfile(uv_os_fd_t socket, uv_file file, std::int64_t offset, std::size_t length) {
+    if (out = ::dup(socket), in = ::dup(file); out < 0 || in < 0) {
+        publish(ErrorEvent{ErrorEvent::translate(errno)});
+        return;
+    }
+
+    invoke(&uv_fs_sendfile, parent(), get(), out, in, offset, length, &sendfileCallback);
+}
+
+UVCLS_INLINE std::size_t SendFileReq::sent() const noexcept {
+    return result;
+}
+
 }  // namespace uvcls
 
 #endif
\ No newline at end of file
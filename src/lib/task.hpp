@@ -0,0 +1,158 @@
+#ifndef UVCLS_TASK_INCLUDE_H
+#define UVCLS_TASK_INCLUDE_H
+
+#include <uv.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include "config.h"
+
+/*
+协作式的长任务（批量解码、compaction 等），通过 Loop::spawn 提交。
+
+1. 任务是可以重复调用的函数，每次调用做 1 段工作，TimeSlice 到期时返回 true 让出 loop，
+   下一轮继续调用；返回 false 表示任务完成。
+2. 每轮 loop 的 idle 阶段执行任务，所有任务共用 1 个时间片（默认 1 ms）。按优先级依次执行，
+   同 1 个优先级轮流执行，低优先级只使用高优先级剩下的时间。
+3. 有任务时 idle handle 处于活动状态，poll 不会阻塞，I/O 回调在两段任务之间执行。
+4. TimeSlice 直接读 uv_hrtime，不用 Loop::hrnow：hrnow 在 1 个阶段内返回缓存的值，任务执行期间不会前进。
+   执行完之后更新 loop 的时间（和 Loop::updateTime 相同），Loop::now、定时器和 poll 的超时不会少算这段时间。
+*/
+
+namespace uvcls {
+
+// 任务的优先级，都低于 I/O 回调
+enum class Priority : std::uint8_t {
+    HIGH,
+    NORMAL,
+    BACKGROUND
+};
+
+// 任务这 1 次可以运行到的时刻
+class TimeSlice final {
+   public:
+    explicit TimeSlice(std::uint64_t end) noexcept
+        : deadline{end} {}
+
+    // 时间片用完时任务应该尽快返回 true
+    bool expired() const noexcept {
+        return uv_hrtime() >= deadline;
+    }
+
+    std::chrono::nanoseconds remaining() const noexcept {
+        auto now = uv_hrtime();
+        return std::chrono::nanoseconds{now < deadline ? deadline - now : 0};
+    }
+
+   private:
+    std::uint64_t deadline;
+};
+
+class Scheduler final {
+    static constexpr std::size_t PRIORITIES = 3;
+
+    static void idleCallback(uv_idle_t *handle);
+
+   public:
+    // 返回 true 表示还有剩余的工作
+    using Job = std::function<bool(const TimeSlice &)>;
+
+    // 只能在 loop 线程中创建和使用
+    explicit Scheduler(uv_loop_t *ref);
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    void spawn(Job job, Priority priority);
+
+    // 每轮 loop 执行任务的总时间
+    void slice(std::chrono::microseconds time) noexcept;
+
+    std::chrono::microseconds slice() const noexcept;
+
+    // 没有完成的任务个数
+    std::size_t size() const noexcept;
+
+    // 关闭底层的 uv_idle_t，Loop::close 时调用
+    void close() noexcept;
+
+   private:
+    void run();
+
+    uv_loop_t *loop;
+    uv_idle_t idle{};
+    std::deque<Job> queues[PRIORITIES]{};
+    std::chrono::microseconds budget{1000};
+    std::size_t count{0};
+};
+
+UVCLS_INLINE Scheduler::Scheduler(uv_loop_t *ref)
+    : loop{ref} {
+    uv_idle_init(loop, &idle);
+    idle.data = this;
+}
+
+UVCLS_INLINE void Scheduler::idleCallback(uv_idle_t *handle) {
+    Scheduler &scheduler = *(static_cast<Scheduler *>(handle->data));
+    scheduler.run();
+}
+
+UVCLS_INLINE void Scheduler::spawn(Job job, Priority priority) {
+    if (!count++) {
+        uv_idle_start(&idle, &idleCallback);
+    }
+
+    queues[static_cast<std::size_t>(priority)].push_back(std::move(job));
+}
+
+UVCLS_INLINE void Scheduler::run() {
+    auto begin = uv_hrtime();
+    auto end = begin + static_cast<std::uint64_t>(std::chrono::nanoseconds{budget}.count());
+    bool first = true;
+
+    for (auto &queue : queues) {
+        // 只执行这一轮开始时已经在队列中的任务，任务中 spawn 的下一轮执行
+        for (auto pending = queue.size(); pending && (first || uv_hrtime() < end); --pending) {
+            auto job = std::move(queue.front());
+            queue.pop_front();
+            first = false;
+
+            if (job(TimeSlice{end})) {
+                queue.push_back(std::move(job));
+            } else {
+                count--;
+            }
+        }
+    }
+
+    uv_update_time(loop);
+
+    if (!count) {
+        uv_idle_stop(&idle);
+    }
+}
+
+UVCLS_INLINE void Scheduler::slice(std::chrono::microseconds time) noexcept {
+    budget = time;
+}
+
+UVCLS_INLINE std::chrono::microseconds Scheduler::slice() const noexcept {
+    return budget;
+}
+
+UVCLS_INLINE std::size_t Scheduler::size() const noexcept {
+    return count;
+}
+
+UVCLS_INLINE void Scheduler::close() noexcept {
+    if (!uv_is_closing(reinterpret_cast<uv_handle_t *>(&idle))) {
+        uv_close(reinterpret_cast<uv_handle_t *>(&idle), nullptr);
+    }
+}
+
+}  // namespace uvcls
+
+#endif
@@ -1,12 +1,178 @@
 #ifndef UVCLS_TCP_INCLUDE_H
 #define UVCLS_TCP_INCLUDE_H
 
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#endif
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include "config.h"
+#include "histogram.hpp"
+#include "poll.hpp"
 #include "stream.hpp"
 #include "util.hpp"
 
+/*
+TCP 的 socket 选项。uv_tcp_init 不会创建 socket，要等到 bind 或者 connect 时才知道地址族，
+SO_REUSEPORT、TCP_FASTOPEN_CONNECT、收发缓冲区这些选项却必须在 bind、connect 之前设置。
+所以没有 socket 时选项先记录下来，bind、connect 时按地址族自己创建 socket，uv_tcp_open 之后
+先设置记录的选项，再交给 libuv 执行 bind、connect。已经有 socket 时立即设置。
+
+这些选项大多只有 Linux 支持，其他平台上设置失败，返回 false。
+*/
+
 namespace uvcls {
 
+namespace internal {
+
+// 平台不支持的选项为 -1
+#ifdef __linux__
+inline constexpr int SOCKOPT_REUSEPORT = SO_REUSEPORT;
+inline constexpr int SOCKOPT_BUSY_POLL = SO_BUSY_POLL;
+inline constexpr int SOCKOPT_FASTOPEN = TCP_FASTOPEN;
+inline constexpr int SOCKOPT_FASTOPEN_CONNECT = TCP_FASTOPEN_CONNECT;
+inline constexpr int SOCKOPT_DEFER_ACCEPT = TCP_DEFER_ACCEPT;
+inline constexpr int SOCKOPT_NOTSENT_LOWAT = TCP_NOTSENT_LOWAT;
+inline constexpr int SOCKOPT_QUICKACK = TCP_QUICKACK;
+inline constexpr int SOCKOPT_CORK = TCP_CORK;
+inline constexpr int SOCKOPT_ZEROCOPY = SO_ZEROCOPY;
+inline constexpr int SOCKOPT_TIMESTAMPING = SO_TIMESTAMPING;
+// 只要软件的接收时间戳
+inline constexpr int TIMESTAMPING_RX = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+#else
+inline constexpr int SOCKOPT_REUSEPORT = -1;
+inline constexpr int SOCKOPT_BUSY_POLL = -1;
+inline constexpr int SOCKOPT_FASTOPEN = -1;
+inline constexpr int SOCKOPT_FASTOPEN_CONNECT = -1;
+inline constexpr int SOCKOPT_DEFER_ACCEPT = -1;
+inline constexpr int SOCKOPT_NOTSENT_LOWAT = -1;
+inline constexpr int SOCKOPT_QUICKACK = -1;
+inline constexpr int SOCKOPT_CORK = -1;
+inline constexpr int SOCKOPT_ZEROCOPY = -1;
+inline constexpr int SOCKOPT_TIMESTAMPING = -1;
+inline constexpr int TIMESTAMPING_RX = 0;
+#endif
+
+#ifdef __linux__
+// 内核的 struct tcp_info（linux/tcp.h）。glibc 的定义比较旧，没有 delivery_rate，
+// 而 linux/tcp.h 又和 netinet/tcp.h 冲突，所以按内核的 ABI 定义到 delivery_rate 为止
+struct KernelTCPInfo {
+    std::uint8_t state;
+    std::uint8_t caState;
+    std::uint8_t retransmits;
+    std::uint8_t probes;
+    std::uint8_t backoff;
+    std::uint8_t options;
+    std::uint8_t wscale;
+    std::uint8_t flags;
+    std::uint32_t rto;
+    std::uint32_t ato;
+    std::uint32_t sndMss;
+    std::uint32_t rcvMss;
+    std::uint32_t unacked;
+    std::uint32_t sacked;
+    std::uint32_t lost;
+    std::uint32_t retrans;
+    std::uint32_t fackets;
+    std::uint32_t lastDataSent;
+    std::uint32_t lastAckSent;
+    std::uint32_t lastDataRecv;
+    std::uint32_t lastAckRecv;
+    std::uint32_t pmtu;
+    std::uint32_t rcvSsthresh;
+    std::uint32_t rtt;
+    std::uint32_t rttvar;
+    std::uint32_t sndSsthresh;
+    std::uint32_t sndCwnd;
+    std::uint32_t advmss;
+    std::uint32_t reordering;
+    std::uint32_t rcvRtt;
+    std::uint32_t rcvSpace;
+    std::uint32_t totalRetrans;
+    std::uint64_t pacingRate;
+    std::uint64_t maxPacingRate;
+    std::uint64_t bytesAcked;
+    std::uint64_t bytesReceived;
+    std::uint32_t segsOut;
+    std::uint32_t segsIn;
+    std::uint32_t notsentBytes;
+    std::uint32_t minRtt;
+    std::uint32_t dataSegsIn;
+    std::uint32_t dataSegsOut;
+    std::uint64_t deliveryRate;
+};
+
+// 读取 fd 的 TCP_INFO，返回内核实际写入的长度，失败时返回 0
+inline socklen_t tcpInfo(int fd, KernelTCPInfo &info) noexcept {
+    socklen_t len = sizeof(info);
+    return ::getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0 ? len : 0;
+}
+#endif
+
+// 等待 socket 创建之后再设置的选项
+struct SocketOption {
+    int level;
+    int name;
+    int value;
+};
+
+// 1 次零拷贝的写。send 和剩余部分的 uv_write 都完成之后才释放 buffer
+struct ZeroCopyWrite {
+    std::shared_ptr<void> buffer;
+    int parts{1};
+    int error{0};
+};
+
+struct ZeroCopySend {
+    std::uint32_t seq;
+    std::size_t length;
+    std::shared_ptr<ZeroCopyWrite> write;
+};
+
+// 零拷贝发送的状态
+struct ZeroCopy {
+    // 内核确认打开 SO_ZEROCOPY 之后才生效
+    std::size_t threshold{0};
+    std::size_t requested{0};
+    // inflight 中 send 的字节数，计入写队列的大小
+    std::size_t bytes{0};
+    // 内核给每次成功的 MSG_ZEROCOPY send 分配的序号，从 0 开始
+    std::uint32_t next{0};
+    // 还没有收到完成通知的 send，按序号排列
+    std::deque<ZeroCopySend> inflight{};
+    // 在 dup 的 fd 上监听错误队列，fd 在 poll 的 CloseEvent 中关闭。EPOLLERR 时 libuv 会停止 poll，armed 随之清零
+    std::shared_ptr<PollHandle> poll{nullptr};
+    int fd{-1};
+    bool armed{false};
+    bool deferred{false};
+    // 关闭时还有未完成的 send，继续在 fd 上读通知，读完之前 handle 和 buffer 都不释放
+    std::shared_ptr<void> keep{nullptr};
+};
+
+// 接收时间戳打开之后自己读 fd 的状态
+struct RxTimestamping {
+    std::shared_ptr<PollHandle> poll{nullptr};
+    std::shared_ptr<LatencyHistogram> histogram{nullptr};
+    bool reading{false};
+};
+
+}  // namespace internal
+
 enum class UVTCPFlags : std::underlying_type_t<uv_tcp_flags> {
     IPV6ONLY = UV_TCP_IPV6ONLY
 };
@@ -22,6 +188,26 @@ struct Addr {
     unsigned int port; /*!< A valid service identifier. */
 };
 
+// TCP_INFO 的快照。读取失败或者平台不支持时 valid 为 false
+struct TCPInfo {
+    bool valid;
+    std::uint8_t state;               /*!< TCP 状态机的状态，1 为 ESTABLISHED */
+    std::chrono::microseconds rtt;    /*!< 平滑后的 RTT */
+    std::chrono::microseconds rttvar; /*!< RTT 的偏差 */
+    std::uint32_t cwnd;               /*!< 拥塞窗口，单位是报文段 */
+    std::uint32_t retransmits;        /*!< 连接建立以来的重传次数 */
+    std::uint32_t unacked;            /*!< 已经发送还没有确认的报文段 */
+    std::uint64_t deliveryRate;       /*!< 最近的投递速率，字节/秒，旧内核为 0 */
+};
+
+// 零拷贝发送的计数
+struct ZeroCopyStats {
+    std::uint64_t sends;       /*!< 用 MSG_ZEROCOPY 发送的次数 */
+    std::uint64_t completions; /*!< 收到完成通知的次数 */
+    std::uint64_t copied;      /*!< 内核实际上还是复制了的次数（例如 loopback） */
+    std::uint64_t fallbacks;   /*!< 达到阈值但是退回到普通写的次数 */
+};
+
 // 对 libuv 用到的类型做封装 uv_handle_type, uv_file, uv_os_fd_t 等
 template <typename T>
 struct UVTypeWrapper {
@@ -107,6 +293,59 @@ Addr address(F &&f, const H *handle) noexcept {
     return addr;
 }
 
+/*
+二进制的 socket 地址，IPv4 和 IPv6 共用 1 个 union，可以直接交给 bind、connect。
+比较和 hash 只看地址族、端口、地址（IPv6 还有 scope id），可以作为 map 的 key。
+字符串只在调用 ip()、str() 时才格式化，用栈上的缓冲区。
+*/
+class SocketAddress final {
+   public:
+    // 空地址，地址族为 AF_UNSPEC
+    SocketAddress() noexcept;
+
+    // 只接受 AF_INET 和 AF_INET6，其他的得到空地址
+    explicit SocketAddress(const sockaddr &addr) noexcept;
+
+    // 解析 1 次，之后可以重复使用。ip 包含 ':' 时按 IPv6 解析，解析失败得到空地址
+    SocketAddress(const std::string &ip, unsigned int port) noexcept;
+
+    int family() const noexcept;
+
+    unsigned int port() const noexcept;
+
+    const sockaddr &raw() const noexcept;
+
+    socklen_t length() const noexcept;
+
+    std::string ip() const;
+
+    // "1.2.3.4:80" 或者 "[::1]:80"
+    std::string str() const;
+
+    // 转换成旧的 Addr
+    Addr addr() const;
+
+    std::size_t hash() const noexcept;
+
+    explicit operator bool() const noexcept;
+
+    bool operator==(const SocketAddress &other) const noexcept;
+
+    bool operator!=(const SocketAddress &other) const noexcept;
+
+    // 先比较地址族，再比较地址，最后比较端口
+    bool operator<(const SocketAddress &other) const noexcept;
+
+   private:
+    int compare(const SocketAddress &other) const noexcept;
+
+    union {
+        sockaddr base;
+        sockaddr_in v4;
+        sockaddr_in6 v6;
+    } storage;
+};
+
 // 类型包装，可以获取到其内部的值
 using OSSocketHandle = UVTypeWrapper<uv_os_sock_t>;
 
@@ -127,6 +366,111 @@ class TCPHandle final : public StreamHandle<TCPHandle, uv_tcp_t> {
 
     bool simultaneousAccepts(bool enable = true);
 
+    // 多个 socket 绑定同 1 个端口，由内核分发连接。要在 bind 之前设置
+    bool reusePort(bool enable);
+
+    bool reusePort() const noexcept;
+
+    // 服务端的 TFO，queue 是还没有完成握手的 TFO 请求的队列长度，0 表示关闭。要在 listen 之前设置
+    bool fastOpen(int queue);
+
+    int fastOpen() const noexcept;
+
+    // 客户端的 TFO，connect 时不发 SYN，数据和第 1 次 write 一起发送。要在 connect 之前设置
+    bool fastOpenConnect(bool enable);
+
+    bool fastOpenConnect() const noexcept;
+
+    // 监听的 socket 在收到数据之后才返回连接，最多等 time（内核按重传次数取整）
+    bool deferAccept(Time time);
+
+    Time deferAccept() const noexcept;
+
+    // 发送队列中没有发出去的数据少于 bytes 时才可写，减少内核中排队的数据
+    bool notSentLowat(std::size_t bytes);
+
+    std::size_t notSentLowat() const noexcept;
+
+    // 立即发送 ACK。内核会在之后自动恢复延迟 ACK，需要时每次读之后重新设置
+    bool quickAck(bool enable);
+
+    bool quickAck() const noexcept;
+
+    // 没有数据时在驱动的接收队列上忙等 time，提高 CPU 降低延迟。调大需要 CAP_NET_ADMIN
+    bool busyPoll(std::chrono::microseconds time);
+
+    std::chrono::microseconds busyPoll() const noexcept;
+
+    // 通过 uv_send_buffer_size、uv_recv_buffer_size 设置。Linux 上读到的是设置值的 2 倍
+    bool sendBufferSize(int bytes);
+
+    int sendBufferSize() const noexcept;
+
+    bool recvBufferSize(int bytes);
+
+    int recvBufferSize() const noexcept;
+
+    // 只发送满的报文，直到取消 cork。和 noDelay 一起使用时用来手动合并小的写
+    bool cork(bool enable);
+
+    bool cork() const noexcept;
+
+    // 读取 TCP_INFO，每次调用都是 1 次 getsockopt
+    TCPInfo info() const noexcept;
+
+    /*
+    开启零拷贝发送（SO_ZEROCOPY），0 表示关闭。之后 write 的 buffer 不小于 threshold，并且 libuv 的写队列为空时，
+    直接用 MSG_ZEROCOPY send，剩下没有发出去的部分交给 uv_write。buffer 在内核的完成通知到达之后才释放，
+    然后发布 WriteEvent。完成通知从 socket 的错误队列中读取：send 之后在这一轮 poll 之前先读 1 次，
+    没有读完时由 dup 出来的 fd 上的 PollHandle 等待 EPOLLERR，不需要定时轮询。
+
+    内核固定页面、处理通知也有开销，小的写反而更慢，阈值一般在 10 KiB 以上。
+
+    没有打开 SO_ZEROCOPY 时内核忽略 MSG_ZEROCOPY，不会有完成通知，所以要读回选项确认之后才使用阈值，
+    失败时返回 false。socket 还没有创建时返回 true，accept、bind、connect 之后再确认，用 getter 检查。
+
+    close 时还有未完成的 send，buffer 保留到通知全部到达，FIN 也要等到这时才发出；对端没有响应时最长是
+    TCP 的重传超时。closeReset 丢弃内核的发送队列，buffer 立即释放。
+    */
+    bool zerocopy(std::size_t threshold);
+
+    // 生效的阈值，没有确认 SO_ZEROCOPY 时为 0
+    std::size_t zerocopy() const noexcept;
+
+    ZeroCopyStats zerocopyStats() const noexcept;
+
+    /*
+    打开内核的软件接收时间戳（SO_TIMESTAMPING），要在 read 之前设置。libuv 用 read 读数据，拿不到控制消息，
+    所以打开之后 read 不再使用 uv_read_start，而是在 dup 的 fd 上用 PollHandle 等待可读，用 recvmsg 读数据和时间戳。
+
+    DataEvent::timestamp 是内核收到数据的时刻，从它到发布 DataEvent 的延迟记入 histogram，包括数据在 socket
+    缓冲区和 loop 中等待的时间。多个连接可以共用 1 个 histogram，为空时连接自己创建 1 个。
+
+    打开之前已经到达的数据没有时间戳（为 0），不记入 histogram。在监听的 socket 上打开时，accept 的连接
+    继承内核的选项，连接建立之后立即到达的数据也有时间戳，但仍然要在连接上调用 timestamping 才会用 recvmsg 读。
+    关闭时如果正在读，换回 uv_read_start 继续读。
+    */
+    bool timestamping(bool enable, std::shared_ptr<LatencyHistogram> histogram = nullptr);
+
+    bool timestamping() const noexcept;
+
+    // 内核到 DataEvent 的延迟，没有打开接收时间戳时为空
+    std::shared_ptr<LatencyHistogram> latency() const noexcept;
+
+    // Handle::close 调用：关闭读时间戳的 PollHandle，还有未完成的零拷贝 send 时继续等待通知
+    void dispose() noexcept;
+
+    // StreamHandle 开始、停止读时调用。打开了接收时间戳时用 PollHandle 自己读 fd，返回 true
+    bool divert(bool start);
+
+    // libuv 的写队列加上还没有收到完成通知的零拷贝 send
+    size_t writeQueueSize() const noexcept;
+
+    using StreamHandle::write;
+
+    template <typename Deleter>
+    void write(std::unique_ptr<char[], Deleter> data, unsigned int len);
+
     void bind(const sockaddr &addr, Flags<Bind> opts = Flags<Bind>{});
 
     template <typename I = IPv4>
@@ -135,12 +479,20 @@ class TCPHandle final : public StreamHandle<TCPHandle, uv_tcp_t> {
     template <typename I = IPv4>
     void bind(Addr addr, Flags<Bind> opts = Flags<Bind>{});
 
+    void bind(const SocketAddress &addr, Flags<Bind> opts = Flags<Bind>{});
+
     template <typename I = IPv4>
     Addr sock() const noexcept;
 
     template <typename I = IPv4>
     Addr peer() const noexcept;
 
+    // 本地地址，不需要指定地址族
+    SocketAddress local() const noexcept;
+
+    // 对端地址。第 1 次调用时 getpeername，之后直接返回缓存的地址
+    const SocketAddress &remote() const noexcept;
+
     void connect(const sockaddr &addr);
 
     template <typename I = IPv4>
@@ -149,9 +501,24 @@ class TCPHandle final : public StreamHandle<TCPHandle, uv_tcp_t> {
     template <typename I = IPv4>
     void connect(Addr addr);
 
+    void connect(const SocketAddress &addr);
+
     void closeReset();
 
+    // accept、open 得到 fd 之后设置记录的选项。StreamHandle 的 accept 会自动调用
+    void attached();
+
    private:
+    // 设置 1 个选项，没有 socket 时先记录下来
+    bool option(int level, int name, int value);
+
+    int option(int level, int name) const noexcept;
+
+    bool apply(const internal::SocketOption &opt) noexcept;
+
+    // bind、connect 之前创建 socket，设置记录的选项
+    bool prepare(int family);
+
     enum {
         DEFAULT,
         FLAGS
@@ -159,8 +526,173 @@ class TCPHandle final : public StreamHandle<TCPHandle, uv_tcp_t> {
 
     // flags 配置用途，不是简简单单的 1 个 int
     unsigned int flags;
+
+    std::vector<internal::SocketOption> pending{};
+    // 连接建立之后对端地址不会变化
+    mutable SocketAddress peerAddress{};
+
+    // 读取错误队列中的完成通知
+    void reap();
+
+    void finish(internal::ZeroCopyWrite &write, int error);
+
+    // 读回 SO_ZEROCOPY，打开了才使用记录的阈值
+    void confirm() noexcept;
+
+    // 还有未完成的 send 时启动监听错误队列的 PollHandle，第一次调用时 dup fd 并创建
+    void arm();
+
+    // 关闭时还有未完成的 send，保留 PollHandle 继续等待，否则 drop
+    void linger() noexcept;
+
+    // 不再等待完成通知：关闭 PollHandle，未完成的 send 直接释放 buffer
+    void drop() noexcept;
+
+    std::unique_ptr<internal::ZeroCopy> zc{nullptr};
+    ZeroCopyStats zcStats{0, 0, 0, 0};
+
+    // 可读时用 recvmsg 读数据和时间戳，直到 EAGAIN 或者用完读预算
+    void receive();
+
+    // 关闭读时间戳用的 PollHandle
+    void unwatch() noexcept;
+
+    std::unique_ptr<internal::RxTimestamping> rx{nullptr};
 };
 
+UVCLS_INLINE SocketAddress::SocketAddress() noexcept {
+    std::memset(&storage, 0, sizeof(storage));
+    storage.base.sa_family = AF_UNSPEC;
+}
+
+UVCLS_INLINE SocketAddress::SocketAddress(const sockaddr &addr) noexcept
+    : SocketAddress{} {
+    if (addr.sa_family == AF_INET) {
+        std::memcpy(&storage.v4, &addr, sizeof(storage.v4));
+    } else if (addr.sa_family == AF_INET6) {
+        std::memcpy(&storage.v6, &addr, sizeof(storage.v6));
+    }
+}
+
+UVCLS_INLINE SocketAddress::SocketAddress(const std::string &ip, unsigned int port) noexcept
+    : SocketAddress{} {
+    auto value = static_cast<int>(port);
+
+    if (ip.find(':') == std::string::npos ? uv_ip4_addr(ip.c_str(), value, &storage.v4) : uv_ip6_addr(ip.c_str(), value, &storage.v6)) {
+        *this = SocketAddress{};
+    }
+}
+
+UVCLS_INLINE int SocketAddress::family() const noexcept {
+    return storage.base.sa_family;
+}
+
+UVCLS_INLINE unsigned int SocketAddress::port() const noexcept {
+    switch (family()) {
+        case AF_INET:
+            return ntohs(storage.v4.sin_port);
+        case AF_INET6:
+            return ntohs(storage.v6.sin6_port);
+        default:
+            return 0;
+    }
+}
+
+UVCLS_INLINE const sockaddr &SocketAddress::raw() const noexcept {
+    return storage.base;
+}
+
+UVCLS_INLINE socklen_t SocketAddress::length() const noexcept {
+    return family() == AF_INET6 ? sizeof(storage.v6) : sizeof(storage.v4);
+}
+
+UVCLS_INLINE std::string SocketAddress::ip() const {
+    char name[INET6_ADDRSTRLEN];
+
+    if (family() == AF_INET && uv_ip4_name(&storage.v4, name, sizeof(name)) == 0) {
+        return name;
+    } else if (family() == AF_INET6 && uv_ip6_name(&storage.v6, name, sizeof(name)) == 0) {
+        return name;
+    }
+
+    return {};
+}
+
+UVCLS_INLINE std::string SocketAddress::str() const {
+    if (!*this) {
+        return {};
+    }
+
+    auto text = family() == AF_INET6 ? "[" + ip() + "]" : ip();
+    return text + ":" + std::to_string(port());
+}
+
+UVCLS_INLINE Addr SocketAddress::addr() const {
+    return Addr{ip(), port()};
+}
+
+UVCLS_INLINE std::size_t SocketAddress::hash() const noexcept {
+    // FNV-1a，只处理参与比较的字节
+    std::uint64_t value = 14695981039346656037ULL;
+    auto mix = [&value](const void *data, std::size_t len) {
+        for (auto byte = static_cast<const unsigned char *>(data); len--; ++byte) {
+            value = (value ^ *byte) * 1099511628211ULL;
+        }
+    };
+
+    auto number = port();
+    mix(&number, sizeof(number));
+
+    if (family() == AF_INET) {
+        mix(&storage.v4.sin_addr, sizeof(storage.v4.sin_addr));
+    } else if (family() == AF_INET6) {
+        mix(&storage.v6.sin6_addr, sizeof(storage.v6.sin6_addr));
+        mix(&storage.v6.sin6_scope_id, sizeof(storage.v6.sin6_scope_id));
+    }
+
+    return static_cast<std::size_t>(value);
+}
+
+UVCLS_INLINE SocketAddress::operator bool() const noexcept {
+    return family() == AF_INET || family() == AF_INET6;
+}
+
+UVCLS_INLINE int SocketAddress::compare(const SocketAddress &other) const noexcept {
+    if (family() != other.family()) {
+        return family() < other.family() ? -1 : 1;
+    }
+
+    int result = 0;
+
+    if (family() == AF_INET) {
+        result = std::memcmp(&storage.v4.sin_addr, &other.storage.v4.sin_addr, sizeof(storage.v4.sin_addr));
+    } else if (family() == AF_INET6) {
+        result = std::memcmp(&storage.v6.sin6_addr, &other.storage.v6.sin6_addr, sizeof(storage.v6.sin6_addr));
+
+        if (!result && storage.v6.sin6_scope_id != other.storage.v6.sin6_scope_id) {
+            result = storage.v6.sin6_scope_id < other.storage.v6.sin6_scope_id ? -1 : 1;
+        }
+    }
+
+    if (!result && port() != other.port()) {
+        result = port() < other.port() ? -1 : 1;
+    }
+
+    return result;
+}
+
+UVCLS_INLINE bool SocketAddress::operator==(const SocketAddress &other) const noexcept {
+    return compare(other) == 0;
+}
+
+UVCLS_INLINE bool SocketAddress::operator!=(const SocketAddress &other) const noexcept {
+    return compare(other) != 0;
+}
+
+UVCLS_INLINE bool SocketAddress::operator<(const SocketAddress &other) const noexcept {
+    return compare(other) < 0;
+}
+
 // TCPHandle 构造函数。首先调用 StreamHandle{std::move(ref)} 然后 tag 和 flags
 UVCLS_INLINE TCPHandle::TCPHandle(std::shared_ptr<Loop> ref, unsigned int f)
     : StreamHandle{std::move(ref)}, tag{f ? FLAGS : DEFAULT}, flags{f} {}
@@ -170,7 +702,11 @@ UVCLS_INLINE bool TCPHandle::init() {
 }
 
 UVCLS_INLINE void TCPHandle::open(OSSocketHandle socket) {
-    invoke(&uv_tcp_open, get(), socket);
+    if (auto err = uv_tcp_open(get(), socket); err) {
+        publish(ErrorEvent{err});
+    } else {
+        attached();
+    }
 }
 
 UVCLS_INLINE bool TCPHandle::noDelay(bool value) {
@@ -185,8 +721,197 @@ UVCLS_INLINE bool TCPHandle::simultaneousAccepts(bool enable) {
     return (0 == uv_tcp_simultaneous_accepts(get(), enable));
 }
 
+UVCLS_INLINE bool TCPHandle::reusePort(bool enable) {
+    return option(SOL_SOCKET, internal::SOCKOPT_REUSEPORT, enable);
+}
+
+UVCLS_INLINE bool TCPHandle::reusePort() const noexcept {
+    return option(SOL_SOCKET, internal::SOCKOPT_REUSEPORT) != 0;
+}
+
+UVCLS_INLINE bool TCPHandle::fastOpen(int queue) {
+    return option(IPPROTO_TCP, internal::SOCKOPT_FASTOPEN, queue);
+}
+
+UVCLS_INLINE int TCPHandle::fastOpen() const noexcept {
+    return option(IPPROTO_TCP, internal::SOCKOPT_FASTOPEN);
+}
+
+UVCLS_INLINE bool TCPHandle::fastOpenConnect(bool enable) {
+    return option(IPPROTO_TCP, internal::SOCKOPT_FASTOPEN_CONNECT, enable);
+}
+
+UVCLS_INLINE bool TCPHandle::fastOpenConnect() const noexcept {
+    return option(IPPROTO_TCP, internal::SOCKOPT_FASTOPEN_CONNECT) != 0;
+}
+
+UVCLS_INLINE bool TCPHandle::deferAccept(Time time) {
+    return option(IPPROTO_TCP, internal::SOCKOPT_DEFER_ACCEPT, static_cast<int>(time.count()));
+}
+
+UVCLS_INLINE TCPHandle::Time TCPHandle::deferAccept() const noexcept {
+    return Time{static_cast<unsigned int>(option(IPPROTO_TCP, internal::SOCKOPT_DEFER_ACCEPT))};
+}
+
+UVCLS_INLINE bool TCPHandle::notSentLowat(std::size_t bytes) {
+    return option(IPPROTO_TCP, internal::SOCKOPT_NOTSENT_LOWAT, static_cast<int>(bytes));
+}
+
+UVCLS_INLINE std::size_t TCPHandle::notSentLowat() const noexcept {
+    return static_cast<std::size_t>(option(IPPROTO_TCP, internal::SOCKOPT_NOTSENT_LOWAT));
+}
+
+UVCLS_INLINE bool TCPHandle::quickAck(bool enable) {
+    return option(IPPROTO_TCP, internal::SOCKOPT_QUICKACK, enable);
+}
+
+UVCLS_INLINE bool TCPHandle::quickAck() const noexcept {
+    return option(IPPROTO_TCP, internal::SOCKOPT_QUICKACK) != 0;
+}
+
+UVCLS_INLINE bool TCPHandle::busyPoll(std::chrono::microseconds time) {
+    return option(SOL_SOCKET, internal::SOCKOPT_BUSY_POLL, static_cast<int>(time.count()));
+}
+
+UVCLS_INLINE std::chrono::microseconds TCPHandle::busyPoll() const noexcept {
+    return std::chrono::microseconds{option(SOL_SOCKET, internal::SOCKOPT_BUSY_POLL)};
+}
+
+UVCLS_INLINE bool TCPHandle::sendBufferSize(int bytes) {
+    return option(SOL_SOCKET, SO_SNDBUF, bytes);
+}
+
+UVCLS_INLINE int TCPHandle::sendBufferSize() const noexcept {
+    return option(SOL_SOCKET, SO_SNDBUF);
+}
+
+UVCLS_INLINE bool TCPHandle::recvBufferSize(int bytes) {
+    return option(SOL_SOCKET, SO_RCVBUF, bytes);
+}
+
+UVCLS_INLINE int TCPHandle::recvBufferSize() const noexcept {
+    return option(SOL_SOCKET, SO_RCVBUF);
+}
+
+UVCLS_INLINE bool TCPHandle::cork(bool enable) {
+    return option(IPPROTO_TCP, internal::SOCKOPT_CORK, enable);
+}
+
+UVCLS_INLINE bool TCPHandle::cork() const noexcept {
+    return option(IPPROTO_TCP, internal::SOCKOPT_CORK) != 0;
+}
+
+UVCLS_INLINE bool TCPHandle::option(int level, int name, int value) {
+    if (name < 0) {
+        return false;
+    }
+
+    internal::SocketOption opt{level, name, value};
+
+    if (uv_os_fd_t fd; uv_fileno(get<uv_handle_t>(), &fd) == 0) {
+        return apply(opt);
+    }
+
+    for (auto &prev : pending) {
+        if (prev.level == level && prev.name == name) {
+            prev.value = value;
+            return true;
+        }
+    }
+
+    pending.push_back(opt);
+    return true;
+}
+
+UVCLS_INLINE int TCPHandle::option(int level, int name) const noexcept {
+    if (name < 0) {
+        return 0;
+    }
+
+    if (uv_os_fd_t fd; uv_fileno(get<uv_handle_t>(), &fd) == 0) {
+        int value = 0;
+
+        // 收发缓冲区按要求走 libuv 的接口，value 为 0 时是读取
+        if (level == SOL_SOCKET && name == SO_SNDBUF) {
+            uv_send_buffer_size(const_cast<uv_handle_t *>(get<uv_handle_t>()), &value);
+        } else if (level == SOL_SOCKET && name == SO_RCVBUF) {
+            uv_recv_buffer_size(const_cast<uv_handle_t *>(get<uv_handle_t>()), &value);
+        } else {
+            socklen_t len = sizeof(value);
+            ::getsockopt(fd, level, name, &value, &len);
+        }
+
+        return value;
+    }
+
+    for (auto &prev : pending) {
+        if (prev.level == level && prev.name == name) {
+            return prev.value;
+        }
+    }
+
+    return 0;
+}
+
+UVCLS_INLINE bool TCPHandle::apply(const internal::SocketOption &opt) noexcept {
+    auto value = opt.value;
+
+    if (opt.level == SOL_SOCKET && opt.name == SO_SNDBUF) {
+        return value > 0 && uv_send_buffer_size(get<uv_handle_t>(), &value) == 0;
+    } else if (opt.level == SOL_SOCKET && opt.name == SO_RCVBUF) {
+        return value > 0 && uv_recv_buffer_size(get<uv_handle_t>(), &value) == 0;
+    }
+
+    uv_os_fd_t fd;
+    uv_fileno(get<uv_handle_t>(), &fd);
+    return ::setsockopt(fd, opt.level, opt.name, &value, sizeof(value)) == 0;
+}
+
+UVCLS_INLINE bool TCPHandle::prepare(int family) {
+    if (pending.empty()) {
+        return true;
+    }
+
+    if (uv_os_fd_t fd; uv_fileno(get<uv_handle_t>(), &fd) != 0) {
+#ifdef __linux__
+        auto sock = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+#else
+        auto sock = ::socket(family, SOCK_STREAM, 0);
+#endif
+
+        if (sock < 0) {
+            publish(ErrorEvent{ErrorEvent::translate(errno)});
+            return false;
+        }
+
+        if (auto err = uv_tcp_open(get(), sock); err) {
+            ::close(sock);
+            publish(ErrorEvent{err});
+            return false;
+        }
+    }
+
+    attached();
+    return true;
+}
+
+UVCLS_INLINE void TCPHandle::attached() {
+    // 设置失败的选项不影响 bind、connect、accept，需要时可以用 getter 检查
+    for (auto &opt : pending) {
+        apply(opt);
+    }
+
+    pending.clear();
+
+    if (zc) {
+        confirm();
+    }
+}
+
 UVCLS_INLINE void TCPHandle::bind(const sockaddr &addr, Flags<Bind> opts) {
-    invoke(&uv_tcp_bind, get(), &addr, opts);
+    if (prepare(addr.sa_family)) {
+        invoke(&uv_tcp_bind, get(), &addr, opts);
+    }
 }
 
 template <typename I>
@@ -211,6 +936,38 @@ UVCLS_INLINE Addr TCPHandle::peer() const noexcept {
     return address<I>(&uv_tcp_getpeername, get());
 }
 
+UVCLS_INLINE SocketAddress TCPHandle::local() const noexcept {
+    sockaddr_storage ssto;
+    int len = sizeof(ssto);
+
+    if (uv_tcp_getsockname(get(), reinterpret_cast<sockaddr *>(&ssto), &len) == 0) {
+        return SocketAddress{reinterpret_cast<const sockaddr &>(ssto)};
+    }
+
+    return SocketAddress{};
+}
+
+UVCLS_INLINE const SocketAddress &TCPHandle::remote() const noexcept {
+    if (!peerAddress) {
+        sockaddr_storage ssto;
+        int len = sizeof(ssto);
+
+        if (uv_tcp_getpeername(get(), reinterpret_cast<sockaddr *>(&ssto), &len) == 0) {
+            peerAddress = SocketAddress{reinterpret_cast<const sockaddr &>(ssto)};
+        }
+    }
+
+    return peerAddress;
+}
+
+UVCLS_INLINE void TCPHandle::bind(const SocketAddress &addr, Flags<Bind> opts) {
+    bind(addr.raw(), std::move(opts));
+}
+
+UVCLS_INLINE void TCPHandle::connect(const SocketAddress &addr) {
+    connect(addr.raw());
+}
+
 template <typename I>
 UVCLS_INLINE void TCPHandle::connect(const std::string &ip, unsigned int port) {
     typename IpTraits<I>::Type addr;
@@ -227,16 +984,486 @@ UVCLS_INLINE void TCPHandle::connect(const sockaddr &addr) {
     auto listener = [ptr = shared_from_this()](const auto &event, const auto &) {
         ptr->publish(event);
     };
+    if (!prepare(addr.sa_family)) {
+        return;
+    }
+
     auto req = std::make_shared<uvcls::ConnectReq>(this->loop().shared_from_this());
     req->once<ErrorEvent>(listener);
     req->once<ConnectEvent>(listener);
     req->connect(&uv_tcp_connect, get(), &addr);
 }
 
+UVCLS_INLINE TCPInfo TCPHandle::info() const noexcept {
+    TCPInfo result{false, 0, std::chrono::microseconds{0}, std::chrono::microseconds{0}, 0, 0, 0, 0};
+
+#ifdef __linux__
+    internal::KernelTCPInfo raw{};
+
+    if (uv_os_fd_t fd; uv_fileno(get<uv_handle_t>(), &fd) == 0) {
+        if (auto len = internal::tcpInfo(fd, raw); len) {
+            result.valid = true;
+            result.state = raw.state;
+            result.rtt = std::chrono::microseconds{raw.rtt};
+            result.rttvar = std::chrono::microseconds{raw.rttvar};
+            result.cwnd = raw.sndCwnd;
+            result.retransmits = raw.totalRetrans;
+            result.unacked = raw.unacked;
+            // 旧内核返回的长度不包括 delivery_rate
+            result.deliveryRate = len >= sizeof(raw) ? raw.deliveryRate : 0;
+        }
+    }
+#endif
+
+    return result;
+}
+
+UVCLS_INLINE bool TCPHandle::zerocopy(std::size_t threshold) {
+    if (!zc) {
+        zc = std::make_unique<internal::ZeroCopy>();
+    }
+
+    zc->requested = threshold;
+    zc->threshold = 0;
+
+    if (!option(SOL_SOCKET, internal::SOCKOPT_ZEROCOPY, threshold > 0)) {
+        return false;
+    }
+
+    // 没有 socket 时选项还在 pending 中，attached 之后再确认
+    if (uv_os_fd_t fd; uv_fileno(get<uv_handle_t>(), &fd) == 0) {
+        confirm();
+        return zc->threshold == threshold;
+    }
+
+    return true;
+}
+
+UVCLS_INLINE std::size_t TCPHandle::zerocopy() const noexcept {
+    return zc ? zc->threshold : 0;
+}
+
+UVCLS_INLINE void TCPHandle::confirm() noexcept {
+    zc->threshold = zc->requested && option(SOL_SOCKET, internal::SOCKOPT_ZEROCOPY) > 0 ? zc->requested : 0;
+}
+
+UVCLS_INLINE size_t TCPHandle::writeQueueSize() const noexcept {
+    return StreamHandle::writeQueueSize() + (zc ? zc->bytes : 0);
+}
+
+UVCLS_INLINE ZeroCopyStats TCPHandle::zerocopyStats() const noexcept {
+    return zcStats;
+}
+
+template <typename Deleter>
+UVCLS_INLINE void TCPHandle::write(std::unique_ptr<char[], Deleter> data, unsigned int len) {
+    uv_os_fd_t fd;
+
+    if (!zc || !zc->threshold || len < zc->threshold) {
+        StreamHandle::write(std::move(data), len);
+        return;
+    }
+
+#ifdef __linux__
+    // 写队列不为空时直接 send 会打乱顺序
+    auto sent = get()->write_queue_size || uv_fileno(get<uv_handle_t>(), &fd) ? -1 : ::send(fd, data.get(), len, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+#else
+    ssize_t sent = -1;
+#endif
+
+    if (sent <= 0) {
+        zcStats.fallbacks++;
+        StreamHandle::write(std::move(data), len);
+        return;
+    }
+
+    auto base = data.get();
+    auto state = std::make_shared<internal::ZeroCopyWrite>();
+    state->buffer = std::make_shared<std::unique_ptr<char[], Deleter>>(std::move(data));
+
+    submit();
+    zc->inflight.push_back(internal::ZeroCopySend{zc->next++, static_cast<std::size_t>(sent), state});
+    zc->bytes += static_cast<std::size_t>(sent);
+    zcStats.sends++;
+
+    if (static_cast<unsigned int>(sent) < len) {
+        state->parts++;
+
+        auto rest = std::unique_ptr<char[], NullDeleter>{base + sent, [](char *) {}};
+        auto req = std::make_shared<WriteReq<NullDeleter>>(loop().shared_from_this(), std::move(rest), len - static_cast<unsigned int>(sent));
+        auto listener = [ptr = shared_from_this(), state](const auto &event, const auto &) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(event)>, ErrorEvent>) {
+                ptr->finish(*state, event.code());
+            } else {
+                ptr->finish(*state, 0);
+            }
+        };
+
+        req->once<ErrorEvent>(listener);
+        req->once<WriteEvent>(listener);
+        req->write(get<uv_stream_t>());
+    }
+
+    arm();
+
+    // loopback 上通知几乎是立即到达的，先在这一轮 poll 之前检查 1 次
+    if (!zc->deferred) {
+        zc->deferred = true;
+        loop().defer([ptr = shared_from_this()]() {
+            ptr->zc->deferred = false;
+            ptr->reap();
+        });
+    }
+}
+
+UVCLS_INLINE void TCPHandle::finish(internal::ZeroCopyWrite &write, int error) {
+    if (error) {
+        write.error = error;
+    }
+
+    if (--write.parts == 0) {
+        write.buffer.reset();
+        written();
+
+        // 关闭之后到达的通知只释放 buffer
+        if (!closing()) {
+            write.error ? publish(ErrorEvent{write.error}) : publish(WriteEvent{});
+        }
+    }
+}
+
+UVCLS_INLINE void TCPHandle::arm() {
+    if (!zc->poll) {
+        uv_os_fd_t fd;
+
+        // dup 失败时只在 write 之后检查，剩下的通知等下一次 write
+        if (uv_fileno(get<uv_handle_t>(), &fd) || (zc->fd = ::dup(fd)) < 0) {
+            zc->fd = -1;
+            return;
+        }
+
+        if (zc->poll = loop().resource<PollHandle>(zc->fd); !zc->poll) {
+            ::close(zc->fd);
+            zc->fd = -1;
+            return;
+        }
+
+        // PRIORITIZED 只是为了注册到 epoll。单独的 EPOLLERR 被 libuv 补上注册的事件，按 PollEvent 回调；
+        // 回调 UV_EBADF 时 libuv 已经停止了 poll。带外数据也会唤醒它，reap 读不到通知时什么都不做
+        auto ready = [wptr = weak_from_this()](const auto &event, auto &) {
+            if (auto ptr = wptr.lock(); ptr) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(event)>, ErrorEvent>) {
+                    ptr->zc->armed = false;
+                }
+
+                ptr->reap();
+            }
+        };
+
+        zc->poll->on<CloseEvent>([copy = zc->fd](const auto &, auto &) { ::close(copy); });
+        zc->poll->on<PollEvent>(ready);
+        zc->poll->on<ErrorEvent>(ready);
+    }
+
+    if (!zc->armed) {
+        zc->armed = true;
+        zc->poll->start(PollHandle::Event::PRIORITIZED);
+    }
+}
+
+UVCLS_INLINE void TCPHandle::linger() noexcept {
+    if (!zc) {
+        return;
+    }
+
+    // dup 的 fd 让 socket 在 handle 关闭之后继续存在，通知读完时关闭
+    if (zc->poll && !zc->inflight.empty()) {
+        zc->keep = shared_from_this();
+    } else {
+        drop();
+    }
+}
+
+UVCLS_INLINE void TCPHandle::drop() noexcept {
+    if (zc->poll) {
+        zc->poll->close();
+        zc->poll = nullptr;
+    }
+
+    zc->fd = -1;
+    zc->armed = false;
+    zc->inflight.clear();
+    zc->bytes = 0;
+}
+
+UVCLS_INLINE void TCPHandle::reap() {
+    // 关闭之后只有 linger 时继续读 dup 的 fd，否则（closeReset）buffer 直接释放
+    auto source = [this]() {
+        uv_os_fd_t fd;
+
+        if (closing()) {
+            return zc->keep ? zc->fd : -1;
+        }
+
+        return zc->poll ? zc->fd : uv_fileno(get<uv_handle_t>(), &fd) ? -1 : fd;
+    };
+
+    if (source() < 0) {
+        drop();
+        return;
+    }
+
+#ifdef __linux__
+    // WriteEvent 的监听函数可能关闭 handle，所以每次都重新取 fd
+    for (int fd; !zc->inflight.empty() && (fd = source()) >= 0;) {
+        char control[CMSG_SPACE(sizeof(sock_extended_err)) + CMSG_SPACE(sizeof(sockaddr_in6))];
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            break;
+        }
+
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+
+            sock_extended_err err;
+            std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+
+            if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+
+            // [ee_info, ee_data] 是已经完成的序号区间，TCP 上按顺序到达
+            auto count = err.ee_data - err.ee_info + 1;
+            zcStats.completions += count;
+
+            if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                zcStats.copied += count;
+            }
+
+            while (!zc->inflight.empty() && zc->inflight.front().seq - err.ee_info < count) {
+                auto write = std::move(zc->inflight.front().write);
+                zc->bytes -= zc->inflight.front().length;
+                zc->inflight.pop_front();
+                finish(*write, 0);
+            }
+        }
+    }
+#endif
+
+    if (!zc->inflight.empty()) {
+        // EPOLLERR 之后 libuv 停止了 poll，还有通知要等时重新启动
+        if (zc->poll && !zc->armed) {
+            zc->armed = true;
+            zc->poll->start(PollHandle::Event::PRIORITIZED);
+        }
+
+        return;
+    }
+
+    if (zc->keep) {
+        drop();
+        // 可能是 poll 的回调，释放自己要放到回调之外
+        loop().defer([self = std::move(zc->keep)]() {});
+    } else if (zc->armed) {
+        // 没有未完成的 send 时不监听，带外数据不会唤醒 loop
+        zc->armed = false;
+        zc->poll->stop();
+    }
+}
+
+UVCLS_INLINE bool TCPHandle::timestamping(bool enable, std::shared_ptr<LatencyHistogram> histogram) {
+    if (!enable) {
+        // 正在读时换回 uv_read_start 继续读
+        auto reading = rx && rx->reading;
+        unwatch();
+        rx = nullptr;
+        auto result = option(SOL_SOCKET, internal::SOCKOPT_TIMESTAMPING, 0);
+
+        if (reading && !closing()) {
+            read();
+        }
+
+        return result;
+    }
+
+    if (!option(SOL_SOCKET, internal::SOCKOPT_TIMESTAMPING, internal::TIMESTAMPING_RX)) {
+        return false;
+    }
+
+    if (!rx) {
+        rx = std::make_unique<internal::RxTimestamping>();
+    }
+
+    rx->histogram = histogram ? std::move(histogram) : std::make_shared<LatencyHistogram>();
+    return true;
+}
+
+UVCLS_INLINE bool TCPHandle::timestamping() const noexcept {
+    return rx != nullptr;
+}
+
+UVCLS_INLINE std::shared_ptr<LatencyHistogram> TCPHandle::latency() const noexcept {
+    return rx ? rx->histogram : nullptr;
+}
+
+UVCLS_INLINE bool TCPHandle::divert(bool start) {
+    uv_os_fd_t fd;
+
+    if (!rx) {
+        return false;
+    }
+
+    if (!start) {
+        rx->reading = false;
+
+        if (rx->poll) {
+            rx->poll->stop();
+        }
+
+        return true;
+    }
+
+    if (!rx->poll) {
+        if (auto err = uv_fileno(get<uv_handle_t>(), &fd); err) {
+            publish(ErrorEvent{err});
+            return true;
+        }
+
+        auto copy = ::dup(fd);
+
+        if (copy < 0) {
+            publish(ErrorEvent{ErrorEvent::translate(errno)});
+            return true;
+        }
+
+        if (rx->poll = loop().resource<PollHandle>(copy); !rx->poll) {
+            ::close(copy);
+            return true;
+        }
+
+        // EPOLLERR 时 libuv 回调 UV_EBADF，真正的错误由 recvmsg 返回
+        auto ready = [wptr = weak_from_this()](const auto &, auto &) {
+            if (auto ptr = wptr.lock(); ptr) {
+                ptr->receive();
+            }
+        };
+
+        rx->poll->on<CloseEvent>([copy](const auto &, auto &) { ::close(copy); });
+        rx->poll->on<PollEvent>(ready);
+        rx->poll->on<ErrorEvent>(ready);
+    }
+
+    rx->reading = true;
+    rx->poll->start(PollHandle::Event::READABLE);
+    return true;
+}
+
+UVCLS_INLINE void TCPHandle::dispose() noexcept {
+    unwatch();
+    linger();
+    StreamHandle::dispose();
+}
+
+UVCLS_INLINE void TCPHandle::receive() {
+#ifdef __linux__
+    // 和 libuv 的 uv__read 相同：每次可读事件最多读 32 次，每次 64 KiB。读预算由 consume 按轮计算
+    constexpr std::size_t READS = 32;
+    constexpr std::size_t SIZE = 64 * 1024;
+    std::size_t reads = 0;
+    uv_os_fd_t fd;
+
+    if (closing() || uv_fileno(get<uv_handle_t>(), &fd)) {
+        return;
+    }
+
+    // 用完读预算时 consume 通过 divert 停止读，rx->reading 随之清零
+    while (rx && rx->reading && !closing() && reads < READS) {
+        auto data = loop().buffers().allocate(SIZE);
+        iovec iov{data.get(), SIZE};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(timespec) * 3)];
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        auto nread = ::recvmsg(fd, &msg, MSG_DONTWAIT);
+        auto err = nread < 0 ? errno : 0;
+
+        if (err == EINTR) {
+            continue;
+        }
+
+        if (err == EAGAIN || err == EWOULDBLOCK) {
+            break;
+        }
+
+        if (nread <= 0) {
+            rx->reading = false;
+            rx->poll->stop();
+            received(err ? ErrorEvent::translate(err) : UV_EOF, std::move(data), std::chrono::nanoseconds{0});
+            break;
+        }
+
+        std::chrono::nanoseconds stamp{0};
+
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                // scm_timestamping 的 ts[0] 是软件时间戳
+                timespec ts[3];
+                std::memcpy(ts, CMSG_DATA(cmsg), sizeof(ts));
+                stamp = std::chrono::seconds{ts[0].tv_sec} + std::chrono::nanoseconds{ts[0].tv_nsec};
+            }
+        }
+
+        if (stamp.count()) {
+            timespec now;
+            ::clock_gettime(CLOCK_REALTIME, &now);
+            rx->histogram->record(std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec} - stamp);
+        }
+
+        reads++;
+        consume(static_cast<std::size_t>(nread));
+        received(nread, std::move(data), stamp);
+    }
+#endif
+}
+
+UVCLS_INLINE void TCPHandle::unwatch() noexcept {
+    if (rx && rx->poll) {
+        rx->poll->close();
+        rx->poll = nullptr;
+    }
+}
+
 UVCLS_INLINE void TCPHandle::closeReset() {
+    unwatch();
+
+    // dup 的 fd 还在时 socket 不会真正关闭，RST 要等到它关闭
+    if (zc) {
+        drop();
+    }
+
+    cancel();
     invoke(&uv_tcp_close_reset, get(), &this->closeCallback);
 }
 
 }  // namespace uvcls
 
+namespace std {
+
+template <>
+struct hash<uvcls::SocketAddress> {
+    std::size_t operator()(const uvcls::SocketAddress &addr) const noexcept {
+        return addr.hash();
+    }
+};
+
+}  // namespace std
+
 #endif
\ No newline at end of file
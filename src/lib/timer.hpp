@@ -0,0 +1,123 @@
+#ifndef UVCLS_TIMER_INCLUDE_H
+#define UVCLS_TIMER_INCLUDE_H
+
+#include <uv.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "handle.hpp"
+
+namespace uvcls {
+
+struct TimerEvent {};
+
+/*
+uv_timer_t 的封装。libuv 的定时器保存在最小堆中，start/stop 是 O(log n)。
+数量很多、频繁重置的定时器（例如每个连接的超时）用 Loop::wheel() 的时间轮。
+
+设置了 slack 之后，每次到期时间都按 internal::coalesce 对齐，repeat 由这里重新 start 实现，
+不再交给 libuv（libuv 的 repeat 会从回调执行的时刻累加，对齐就失效了）。
+*/
+class TimerHandle final : public Handle<TimerHandle, uv_timer_t> {
+    static void startCallback(uv_timer_t *handle);
+
+   public:
+    using Time = std::chrono::duration<uint64_t, std::milli>;
+
+    using Handle::Handle;
+
+    bool init();
+
+    // timeout 之后发布 TimerEvent，repeat 不为 0 时之后每隔 repeat 发布 1 次
+    void start(Time timeout, Time repeat);
+
+    void stop();
+
+    // 用 repeat 的值重新开始计时，没有设置 repeat 时发布 ErrorEvent
+    void again();
+
+    void repeat(Time repeat);
+
+    Time repeat();
+
+    // 允许推迟执行的时间，用于统计刷新、keep-alive 检查这类不需要精确到毫秒的定时器
+    void slack(Time slack);
+
+    Time slack() const noexcept;
+
+   private:
+    // 对齐之后距离现在的毫秒数
+    std::uint64_t align(Time timeout) const noexcept;
+
+    Time window{0};
+    Time interval{0};
+};
+
+UVCLS_INLINE void TimerHandle::startCallback(uv_timer_t *handle) {
+    TimerHandle &timer = *(static_cast<TimerHandle *>(handle->data));
+
+    if (timer.window.count() && timer.interval.count()) {
+        uv_timer_start(handle, &startCallback, timer.align(timer.interval), 0);
+    }
+
+    timer.publish(TimerEvent{});
+}
+
+UVCLS_INLINE std::uint64_t TimerHandle::align(TimerHandle::Time timeout) const noexcept {
+    auto now = loop().now().count();
+    return internal::coalesce(now + timeout.count(), window.count()) - now;
+}
+
+UVCLS_INLINE bool TimerHandle::init() {
+    return initialize(&uv_timer_init);
+}
+
+UVCLS_INLINE void TimerHandle::start(TimerHandle::Time timeout, TimerHandle::Time repeat) {
+    interval = repeat;
+
+    if (window.count()) {
+        invoke(&uv_timer_start, get(), &startCallback, align(timeout), 0);
+    } else {
+        invoke(&uv_timer_start, get(), &startCallback, timeout.count(), repeat.count());
+    }
+}
+
+UVCLS_INLINE void TimerHandle::stop() {
+    invoke(&uv_timer_stop, get());
+}
+
+UVCLS_INLINE void TimerHandle::again() {
+    if (!window.count()) {
+        invoke(&uv_timer_again, get());
+    } else if (interval.count()) {
+        invoke(&uv_timer_start, get(), &startCallback, align(interval), 0);
+    } else {
+        publish(ErrorEvent{static_cast<int>(UV_EINVAL)});
+    }
+}
+
+UVCLS_INLINE void TimerHandle::repeat(TimerHandle::Time repeat) {
+    interval = repeat;
+
+    if (!window.count()) {
+        uv_timer_set_repeat(get(), repeat.count());
+    }
+}
+
+UVCLS_INLINE TimerHandle::Time TimerHandle::repeat() {
+    return interval;
+}
+
+UVCLS_INLINE void TimerHandle::slack(TimerHandle::Time slack) {
+    window = slack;
+    uv_timer_set_repeat(get(), window.count() ? 0 : interval.count());
+}
+
+UVCLS_INLINE TimerHandle::Time TimerHandle::slack() const noexcept {
+    return window;
+}
+
+}  // namespace uvcls
+
+#endif
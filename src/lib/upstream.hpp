@@ -0,0 +1,504 @@
+#ifndef UVCLS_UPSTREAM_INCLUDE_H
+#define UVCLS_UPSTREAM_INCLUDE_H
+
+#include <uv.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+#include <sys/socket.h>
+
+#include "config.h"
+#include "emitter.hpp"
+#include "loop.hpp"
+#include "tcp.hpp"
+#include "wheel.hpp"
+
+/*
+出站 TCP 连接池，按 SocketAddress 分组，每个 loop 1 个。
+
+1. checkout 优先取最近归还的空闲连接（LIFO，拥塞窗口和缓存都比较热），没有时在 total 的限制内新建连接，
+   达到上限时排队，等其他连接归还或者关闭。
+2. 空闲连接一直在读：读到 EOF、出错或者收到数据（协议状态未知）都认为连接已经坏掉，直接关闭。
+   checkout 时再用 MSG_PEEK 检查 1 次，处理这一轮还没有回调的 FIN。
+3. 每个地址 1 个 WheelTimer，空闲超过 timeout 的连接从最旧的开始关闭。
+4. warm 之后空闲连接保持在 PoolPolicy::warm 以上，被取走、坏掉时自动补充，建连失败时停止预热。
+5. checkin 时清除调用者在连接上注册的所有监听函数。
+*/
+
+namespace uvcls {
+
+// 每个地址的限制
+struct PoolPolicy {
+    std::size_t idle{8};                          /*!< 最多保留的空闲连接 */
+    std::size_t total{64};                        /*!< 最多的连接数，包括使用中和正在建立的 */
+    std::size_t warm{0};                          /*!< warm 之后保持的最少空闲连接 */
+    std::chrono::milliseconds timeout{30000};     /*!< 空闲超过这个时间的连接被关闭，0 表示不关闭 */
+    bool fastOpen{false};                         /*!< 新连接打开 TCP_FASTOPEN_CONNECT */
+};
+
+struct PoolStats {
+    std::uint64_t created; /*!< 新建的连接数 */
+    std::uint64_t reused;  /*!< 复用空闲连接的次数 */
+    std::uint64_t evicted; /*!< 空闲超时或者超过 idle 被关闭的连接数 */
+    std::uint64_t broken;  /*!< 空闲时坏掉的连接数 */
+    std::size_t idle;      /*!< 当前的空闲连接数 */
+    std::size_t total;     /*!< 当前的连接数 */
+};
+
+namespace internal {
+
+struct IdleConnection {
+    std::shared_ptr<TCPHandle> handle;
+    std::uint64_t since; /*!< 归还时的 uv_now */
+};
+
+// 1 个地址的连接
+struct Upstream {
+    using Callback = std::function<void(std::shared_ptr<TCPHandle>, int)>;
+
+    std::deque<IdleConnection> idle{};    /*!< 最近归还的在末尾 */
+    std::deque<Callback> waiters{};
+    WheelTimer expiry{};
+    std::size_t total{0};
+    std::size_t warming{0};
+    bool warm{false};
+};
+
+}  // namespace internal
+
+class ConnectionPool final : public Emitter<ConnectionPool>, public std::enable_shared_from_this<ConnectionPool> {
+   public:
+    // 成功时 status 为 0；失败时 handle 为空，status 是 libuv 的错误码
+    using Callback = internal::Upstream::Callback;
+
+    explicit ConnectionPool(std::shared_ptr<Loop> ref, PoolPolicy policy = {});
+
+    ConnectionPool(const ConnectionPool &) = delete;
+    ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+    ~ConnectionPool() noexcept;
+
+    // 对之后的 checkout、checkin 生效
+    void policy(PoolPolicy value) noexcept;
+
+    PoolPolicy policy() const noexcept;
+
+    // 有空闲连接时同步回调，否则在连接建立或者有连接归还时回调
+    void checkout(const SocketAddress &addr, Callback callback);
+
+    // 归还连接。已经关闭或者不是池中创建的连接直接关闭
+    void checkin(std::shared_ptr<TCPHandle> handle);
+
+    // 建立连接直到 addr 的空闲连接达到 PoolPolicy::warm
+    void warm(const SocketAddress &addr);
+
+    std::size_t idle(const SocketAddress &addr) const;
+
+    std::size_t total(const SocketAddress &addr) const;
+
+    PoolStats stats() const noexcept;
+
+    // 关闭所有空闲连接，等待中的 checkout 以 UV_ECANCELED 回调。使用中的连接归还时关闭
+    void close();
+
+   private:
+    internal::Upstream &upstream(const SocketAddress &addr);
+
+    void dial(const SocketAddress &addr, Callback callback);
+
+    // 交给等待者，或者放进空闲队列
+    void offer(const SocketAddress &addr, std::shared_ptr<TCPHandle> handle);
+
+    std::shared_ptr<TCPHandle> take(const SocketAddress &addr, internal::Upstream &state);
+
+    // 连接关闭时减少计数
+    void track(TCPHandle &handle, const SocketAddress &addr);
+
+    void released(const SocketAddress &addr, const TCPHandle *handle);
+
+    void discard(const SocketAddress &addr, const TCPHandle *handle, std::uint64_t &counter);
+
+    void refill(const SocketAddress &addr);
+
+    void expire(const SocketAddress &addr);
+
+    void schedule(internal::Upstream &state);
+
+    static bool healthy(TCPHandle &handle) noexcept;
+
+    std::shared_ptr<Loop> loop;
+    PoolPolicy limits;
+    std::unordered_map<SocketAddress, internal::Upstream> upstreams{};
+    std::unordered_map<const TCPHandle *, SocketAddress> owners{};
+    std::uint64_t created{0};
+    std::uint64_t reused{0};
+    std::uint64_t evicted{0};
+    std::uint64_t broken{0};
+    bool running{true};
+};
+
+UVCLS_INLINE ConnectionPool::ConnectionPool(std::shared_ptr<Loop> ref, PoolPolicy policy)
+    : loop{std::move(ref)}, limits{policy} {}
+
+UVCLS_INLINE ConnectionPool::~ConnectionPool() noexcept {
+    for (auto &[addr, state] : upstreams) {
+        loop->wheel().cancel(state.expiry);
+
+        for (auto &entry : state.idle) {
+            entry.handle->close();
+        }
+    }
+}
+
+UVCLS_INLINE void ConnectionPool::policy(PoolPolicy value) noexcept {
+    limits = value;
+}
+
+UVCLS_INLINE PoolPolicy ConnectionPool::policy() const noexcept {
+    return limits;
+}
+
+UVCLS_INLINE void ConnectionPool::checkout(const SocketAddress &addr, Callback callback) {
+    if (!running) {
+        callback(nullptr, UV_ECANCELED);
+        return;
+    }
+
+    auto &state = upstream(addr);
+
+    if (auto handle = take(addr, state); handle) {
+        reused++;
+        callback(std::move(handle), 0);
+        refill(addr);
+    } else if (state.total < limits.total) {
+        dial(addr, std::move(callback));
+    } else {
+        state.waiters.push_back(std::move(callback));
+    }
+}
+
+UVCLS_INLINE void ConnectionPool::checkin(std::shared_ptr<TCPHandle> handle) {
+    auto it = owners.find(handle.get());
+
+    if (it == owners.end()) {
+        handle->close();
+        return;
+    }
+
+    auto addr = it->second;
+    handle->clear();
+    track(*handle, addr);
+
+    if (!running || handle->closing()) {
+        handle->close();
+        return;
+    }
+
+    handle->stop();
+    offer(addr, std::move(handle));
+}
+
+UVCLS_INLINE void ConnectionPool::warm(const SocketAddress &addr) {
+    if (running) {
+        upstream(addr).warm = true;
+        refill(addr);
+    }
+}
+
+UVCLS_INLINE std::size_t ConnectionPool::idle(const SocketAddress &addr) const {
+    auto it = upstreams.find(addr);
+    return it == upstreams.end() ? 0 : it->second.idle.size();
+}
+
+UVCLS_INLINE std::size_t ConnectionPool::total(const SocketAddress &addr) const {
+    auto it = upstreams.find(addr);
+    return it == upstreams.end() ? 0 : it->second.total;
+}
+
+UVCLS_INLINE PoolStats ConnectionPool::stats() const noexcept {
+    PoolStats result{created, reused, evicted, broken, 0, 0};
+
+    for (auto &[addr, state] : upstreams) {
+        result.idle += state.idle.size();
+        result.total += state.total;
+    }
+
+    return result;
+}
+
+UVCLS_INLINE void ConnectionPool::close() {
+    running = false;
+
+    for (auto &[addr, state] : upstreams) {
+        decltype(state.idle) idle;
+        decltype(state.waiters) waiters;
+        idle.swap(state.idle);
+        waiters.swap(state.waiters);
+        state.warm = false;
+        loop->wheel().cancel(state.expiry);
+
+        for (auto &entry : idle) {
+            entry.handle->close();
+        }
+
+        for (auto &callback : waiters) {
+            callback(nullptr, UV_ECANCELED);
+        }
+    }
+}
+
+UVCLS_INLINE internal::Upstream &ConnectionPool::upstream(const SocketAddress &addr) {
+    auto [it, inserted] = upstreams.try_emplace(addr);
+
+    if (inserted) {
+        // Upstream 和池的生命周期相同，析构时取消定时器
+        it->second.expiry.on([this, addr]() { expire(addr); });
+    }
+
+    return it->second;
+}
+
+UVCLS_INLINE void ConnectionPool::dial(const SocketAddress &addr, Callback callback) {
+    auto handle = loop->resource<TCPHandle>();
+
+    if (!handle) {
+        if (callback) {
+            callback(nullptr, UV_ENOMEM);
+        } else {
+            upstream(addr).warm = false;
+        }
+
+        return;
+    }
+
+    auto &state = upstream(addr);
+    bool prewarm = !callback;
+    state.total++;
+    state.warming += prewarm;
+    created++;
+    owners[handle.get()] = addr;
+    track(*handle, addr);
+
+    if (limits.fastOpen) {
+        handle->fastOpenConnect(true);
+    }
+
+    auto failed = handle->once<ErrorEvent>([wptr = weak_from_this(), addr, callback](const auto &event, auto &hndl) {
+        hndl.close();
+
+        if (auto ptr = wptr.lock(); ptr) {
+            auto &up = ptr->upstream(addr);
+
+            if (callback) {
+                callback(nullptr, event.code());
+            } else {
+                // 预热失败时停止，避免对不可用的地址反复建连
+                up.warming--;
+                up.warm = false;
+                ptr->publish(event);
+            }
+        }
+    });
+
+    handle->once<ConnectEvent>([wptr = weak_from_this(), addr, callback, failed](const auto &, auto &hndl) {
+        hndl.erase(failed);
+
+        if (auto ptr = wptr.lock(); ptr) {
+            if (!callback) {
+                ptr->upstream(addr).warming--;
+                ptr->offer(addr, hndl.shared_from_this());
+            } else if (ptr->running) {
+                callback(hndl.shared_from_this(), 0);
+            } else {
+                hndl.close();
+                callback(nullptr, UV_ECANCELED);
+            }
+        } else {
+            hndl.close();
+
+            if (callback) {
+                callback(nullptr, UV_ECANCELED);
+            }
+        }
+    });
+
+    handle->connect(addr);
+}
+
+UVCLS_INLINE void ConnectionPool::offer(const SocketAddress &addr, std::shared_ptr<TCPHandle> handle) {
+    auto &state = upstream(addr);
+
+    if (!running) {
+        handle->close();
+        return;
+    }
+
+    if (!state.waiters.empty()) {
+        if (!healthy(*handle)) {
+            broken++;
+            handle->close();
+            return;
+        }
+
+        auto callback = std::move(state.waiters.front());
+        state.waiters.pop_front();
+        reused++;
+        callback(std::move(handle), 0);
+        return;
+    }
+
+    if (state.idle.size() >= limits.idle) {
+        evicted++;
+        handle->close();
+        return;
+    }
+
+    // 空闲时读到任何东西都说明连接不能再用了
+    auto raw = handle.get();
+    auto bad = [wptr = weak_from_this(), addr, raw](const auto &, auto &) {
+        if (auto ptr = wptr.lock(); ptr) {
+            ptr->discard(addr, raw, ptr->broken);
+        }
+    };
+
+    handle->on<DataEvent>(bad);
+    handle->on<EndEvent>(bad);
+    handle->on<ErrorEvent>(bad);
+    handle->read();
+
+    state.idle.push_back(internal::IdleConnection{std::move(handle), uv_now(loop->raw())});
+
+    if (!state.expiry.pending()) {
+        schedule(state);
+    }
+}
+
+UVCLS_INLINE std::shared_ptr<TCPHandle> ConnectionPool::take(const SocketAddress &addr, internal::Upstream &state) {
+    while (!state.idle.empty()) {
+        auto handle = std::move(state.idle.back().handle);
+        state.idle.pop_back();
+
+        // 去掉空闲时的监听函数
+        handle->clear();
+        handle->stop();
+        track(*handle, addr);
+
+        if (healthy(*handle)) {
+            if (state.idle.empty()) {
+                loop->wheel().cancel(state.expiry);
+            }
+
+            return handle;
+        }
+
+        broken++;
+        handle->close();
+    }
+
+    loop->wheel().cancel(state.expiry);
+    return nullptr;
+}
+
+UVCLS_INLINE void ConnectionPool::track(TCPHandle &handle, const SocketAddress &addr) {
+    handle.once<CloseEvent>([wptr = weak_from_this(), addr](const auto &, auto &hndl) {
+        if (auto ptr = wptr.lock(); ptr) {
+            ptr->released(addr, &hndl);
+        }
+    });
+}
+
+UVCLS_INLINE void ConnectionPool::released(const SocketAddress &addr, const TCPHandle *handle) {
+    auto &state = upstream(addr);
+    auto it = std::find_if(state.idle.begin(), state.idle.end(), [handle](auto &entry) { return entry.handle.get() == handle; });
+
+    if (it != state.idle.end()) {
+        state.idle.erase(it);
+    }
+
+    owners.erase(handle);
+    state.total--;
+
+    if (running) {
+        refill(addr);
+    }
+}
+
+UVCLS_INLINE void ConnectionPool::discard(const SocketAddress &addr, const TCPHandle *handle, std::uint64_t &counter) {
+    auto &state = upstream(addr);
+    auto it = std::find_if(state.idle.begin(), state.idle.end(), [handle](auto &entry) { return entry.handle.get() == handle; });
+
+    if (it != state.idle.end()) {
+        auto victim = std::move(it->handle);
+        state.idle.erase(it);
+        counter++;
+        victim->close();
+    }
+}
+
+UVCLS_INLINE void ConnectionPool::refill(const SocketAddress &addr) {
+    auto &state = upstream(addr);
+
+    while (running && !state.waiters.empty() && state.total < limits.total) {
+        auto callback = std::move(state.waiters.front());
+        state.waiters.pop_front();
+        dial(addr, std::move(callback));
+    }
+
+    while (running && state.warm && state.idle.size() + state.warming < limits.warm && state.total < limits.total) {
+        dial(addr, nullptr);
+    }
+}
+
+UVCLS_INLINE void ConnectionPool::expire(const SocketAddress &addr) {
+    auto &state = upstream(addr);
+    auto now = uv_now(loop->raw());
+    auto timeout = static_cast<std::uint64_t>(limits.timeout.count());
+    // 预热的地址保留 warm 个空闲连接
+    auto keep = state.warm ? limits.warm : 0;
+
+    while (timeout && state.idle.size() > keep && state.idle.front().since + timeout <= now) {
+        auto victim = std::move(state.idle.front().handle);
+        state.idle.pop_front();
+        evicted++;
+        victim->close();
+    }
+
+    schedule(state);
+}
+
+UVCLS_INLINE void ConnectionPool::schedule(internal::Upstream &state) {
+    auto timeout = static_cast<std::uint64_t>(limits.timeout.count());
+
+    if (!timeout || state.idle.empty() || (state.warm && state.idle.size() <= limits.warm)) {
+        loop->wheel().cancel(state.expiry);
+        return;
+    }
+
+    auto now = uv_now(loop->raw());
+    auto deadline = state.idle.front().since + timeout;
+    loop->wheel().schedule(state.expiry, deadline > now ? deadline - now : 0);
+}
+
+UVCLS_INLINE bool ConnectionPool::healthy(TCPHandle &handle) noexcept {
+    uv_os_fd_t fd;
+    char byte;
+
+    if (handle.closing() || uv_fileno(handle.get<uv_handle_t>(), &fd)) {
+        return false;
+    }
+
+    // 0 是 FIN，> 0 是多余的数据，只有 EAGAIN 说明连接还是干净的
+    auto n = ::recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+}  // namespace uvcls
+
+#endif
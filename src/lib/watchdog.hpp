@@ -0,0 +1,364 @@
+#ifndef UVCLS_WATCHDOG_INCLUDE_H
+#define UVCLS_WATCHDOG_INCLUDE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "config.h"
+#include "emitter.hpp"
+#include "queue.hpp"
+
+/*
+loop 的看门狗。loop 每轮在 check 阶段对 heartbeat 做 1 次 relaxed store，每次进出 uv_run 再各对 running 做
+1 次 relaxed store（SPIN 模式每轮都要进出 uv_run，合计每轮 3 次，都只写 loop 自己的缓存行），除此之外不需要做任何事。
+
+看门狗线程每 threshold / 4 检查 1 次：
+1. heartbeat 变化了，或者 loop 线程阻塞在 epoll_wait 中（空闲，从 /proc/self/task/<tid>/syscall 读取），
+   说明 loop 没有卡住。
+2. 否则超过 threshold 没有进展时，向 loop 线程发送信号，在信号处理函数中 backtrace 采样调用栈，
+   在看门狗线程中解析符号，从 Emitter<...>::Listener<E>::publish 帧得到正在处理的事件类型，
+   然后在看门狗线程中发布 StallEvent。每次卡住只发布 1 次。
+
+信号：
+1. 默认用 SIGURG。它的默认动作是忽略，多余的信号不会杀死进程；libuv 不使用它。唯一的常见用途是 TCP 带外数据
+   （F_SETOWN 之后内核发送），所以处理函数只处理看门狗自己用 pthread_kill 发送的信号（SI_TKILL，并且有采样请求），
+   其他的交给之前安装的处理函数。应用已经在用 SIGURG 时可以在 start 中换成其他信号，例如 SIGRTMIN + n。
+2. 第 1 个 start 的看门狗保存原来的 sigaction，最后 1 个 stop 的看门狗恢复。
+3. backtrace 不是 async-signal-safe：第 1 次调用会加载 libgcc（start 中先调用 1 次），之后 libgcc 查找 unwind 信息
+   在 glibc 2.35 之前要拿 dl_iterate_phdr 的锁，loop 线程正好卡在 dlopen 中时信号处理函数会死锁；2.35 之后用
+   _dl_find_object，不拿锁。看门狗最多等 100 ms，拿不到调用栈时 frames 为空。
+4. 每次采样请求带 1 个序号。处理函数先把调用栈采到自己的栈上，用 CAS 认领请求成功之后才写共享的 frames，
+   写完回写序号；看门狗只接受序号相同的结果。超时撤回的请求不能再被认领，晚到的信号不会覆盖下 1 次采样的结果。
+
+符号需要链接时加 -rdynamic。只支持 Linux，其他平台 start 时发布 ErrorEvent。
+*/
+
+namespace uvcls {
+
+// loop 卡住的记录，在看门狗线程中发布
+struct StallEvent {
+    std::chrono::milliseconds duration; /*!< 发现时已经卡住的时间 */
+    std::uint64_t iteration;            /*!< 卡住时 loop 的轮数 */
+    std::string event;                  /*!< 正在发布的事件类型，没有找到时为空 */
+    std::vector<std::string> frames;    /*!< loop 线程的调用栈 */
+};
+
+namespace internal {
+
+// loop 和看门狗共享的状态
+struct Heartbeat {
+    alignas(CACHE_LINE) std::atomic<std::uint64_t> beat{0};
+    // loop 在 uv_run 中，每次进出 uv_run 各写 1 次
+    std::atomic<bool> running{false};
+#ifdef __linux__
+    std::atomic<pthread_t> thread{};
+    std::atomic<pid_t> tid{0};
+#endif
+};
+
+#ifdef __linux__
+// 信号处理函数中采样调用栈。同一时刻只有 1 个看门狗在采样
+struct Sampler {
+    static constexpr int DEPTH = 64;
+
+    inline static std::mutex mutex{};
+    inline static void *frames[DEPTH]{};
+    inline static int depth{0};
+    // 等待处理的请求序号，0 表示没有请求。看门狗发送信号之前设置，处理函数据此区分其他来源的信号
+    inline static std::atomic<std::uint64_t> requested{0};
+    // 处理函数写完 frames、depth 之后回写的序号
+    inline static std::atomic<std::uint64_t> answered{0};
+    // 上一次请求的序号，mutex 保护
+    inline static std::uint64_t sequence{0};
+    // 每个信号上运行中的看门狗个数和安装之前的 sigaction，mutex 保护
+    inline static int users[NSIG]{};
+    inline static struct sigaction previous[NSIG]{};
+
+    static void handler(int signo, siginfo_t *info, void *context) {
+        if (auto seq = requested.load(std::memory_order_acquire); info && info->si_code == SI_TKILL && info->si_pid == ::getpid() && seq) {
+            void *local[DEPTH];
+            auto count = ::backtrace(local, DEPTH);
+
+            // 认领失败说明看门狗已经超时撤回了这个请求，不再写 frames
+            if (requested.compare_exchange_strong(seq, 0, std::memory_order_acq_rel)) {
+                std::copy(local, local + count, frames);
+                depth = count;
+                answered.store(seq, std::memory_order_release);
+            }
+
+            return;
+        }
+
+        // 不是看门狗发送的，交给原来的处理函数。只在安装之后读 previous，安装时信号还没有指向这里
+        auto &old = previous[signo];
+
+        if (old.sa_flags & SA_SIGINFO) {
+            old.sa_sigaction(signo, info, context);
+        } else if (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN) {
+            old.sa_handler(signo);
+        }
+    }
+
+    // 第 1 个使用者安装处理函数
+    static bool install(int signo) {
+        if (signo <= 0 || signo >= NSIG) {
+            return false;
+        }
+
+        if (users[signo]++) {
+            return true;
+        }
+
+        struct sigaction action {};
+        action.sa_sigaction = &handler;
+        action.sa_flags = SA_RESTART | SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+
+        if (::sigaction(signo, &action, &previous[signo]) != 0) {
+            users[signo]--;
+            return false;
+        }
+
+        return true;
+    }
+
+    // 最后 1 个使用者恢复原来的处理函数
+    static void uninstall(int signo) {
+        if (signo > 0 && signo < NSIG && users[signo] && !--users[signo]) {
+            ::sigaction(signo, &previous[signo], nullptr);
+        }
+    }
+};
+#endif
+
+}  // namespace internal
+
+class Watchdog final : public Emitter<Watchdog> {
+   public:
+    // 默认用 SIGURG：默认动作是忽略，libuv 也不使用。原因和带外数据的处理见文件开头
+#ifdef __linux__
+    static constexpr int SIGNAL = SIGURG;
+#else
+    static constexpr int SIGNAL = 0;
+#endif
+
+    explicit Watchdog(const internal::Heartbeat &ref) noexcept
+        : heartbeat{ref} {}
+
+    Watchdog(const Watchdog &) = delete;
+    Watchdog &operator=(const Watchdog &) = delete;
+
+    ~Watchdog() noexcept;
+
+    // 启动看门狗线程。StallEvent 的监听函数要在 start 之前注册，它们在看门狗线程中执行
+    void start(std::chrono::milliseconds threshold, int signal = SIGNAL);
+
+    // 停止线程，最后 1 个使用这个信号的看门狗恢复原来的 sigaction
+    void stop() noexcept;
+
+    bool active() const noexcept;
+
+   private:
+    void run();
+
+    // loop 线程阻塞在 epoll 中，或者不在 uv_run 中
+    bool idle() const;
+
+    StallEvent sample(std::chrono::milliseconds duration, std::uint64_t iteration);
+
+    const internal::Heartbeat &heartbeat;
+    std::thread thread{};
+    std::mutex mutex{};
+    std::condition_variable cv{};
+    std::chrono::milliseconds limit{0};
+    int signo{0};
+    bool stopped{true};
+};
+
+UVCLS_INLINE Watchdog::~Watchdog() noexcept {
+    stop();
+}
+
+UVCLS_INLINE void Watchdog::start(std::chrono::milliseconds threshold, int signal) {
+#ifdef __linux__
+    stop();
+
+    {
+        std::lock_guard<std::mutex> lock{internal::Sampler::mutex};
+        // 第一次调用 backtrace 会加载 libgcc，不能在信号处理函数中发生
+        void *warm[1];
+        ::backtrace(warm, 1);
+
+        if (!internal::Sampler::install(signal)) {
+            publish(ErrorEvent{static_cast<int>(UV_EINVAL)});
+            return;
+        }
+    }
+
+    limit = threshold;
+    signo = signal;
+    stopped = false;
+    thread = std::thread{&Watchdog::run, this};
+#else
+    publish(ErrorEvent{static_cast<int>(UV_ENOTSUP)});
+#endif
+}
+
+UVCLS_INLINE void Watchdog::stop() noexcept {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopped = true;
+    }
+
+    cv.notify_all();
+
+    if (thread.joinable()) {
+        thread.join();
+
+#ifdef __linux__
+        std::lock_guard<std::mutex> lock{internal::Sampler::mutex};
+        internal::Sampler::uninstall(signo);
+#endif
+    }
+}
+
+UVCLS_INLINE bool Watchdog::active() const noexcept {
+    return thread.joinable();
+}
+
+UVCLS_INLINE bool Watchdog::idle() const {
+#ifdef __linux__
+    if (!heartbeat.running.load(std::memory_order_relaxed)) {
+        return true;
+    }
+
+    auto base = "/proc/self/task/" + std::to_string(heartbeat.tid.load(std::memory_order_relaxed));
+    long number = -1;
+
+    if (std::ifstream file{base + "/syscall"}; file >> number) {
+        return number == SYS_epoll_wait || number == SYS_epoll_pwait;
+    }
+
+    // 读不到 syscall（没有 ptrace 权限）时退化为线程状态：没有在运行就认为是空闲
+    std::string stat;
+    std::getline(std::ifstream{base + "/stat"}, stat);
+    auto pos = stat.rfind(')');
+    return pos != std::string::npos && pos + 2 < stat.size() && stat[pos + 2] != 'R';
+#else
+    return true;
+#endif
+}
+
+UVCLS_INLINE void Watchdog::run() {
+    using namespace std::chrono;
+
+    auto tick = std::max(limit / 4, milliseconds{1});
+    auto last = heartbeat.beat.load(std::memory_order_relaxed);
+    auto progress = steady_clock::now();
+    bool reported = false;
+    std::unique_lock<std::mutex> lock{mutex};
+
+    while (!cv.wait_for(lock, tick, [this]() { return stopped; })) {
+        auto now = steady_clock::now();
+
+        if (auto beat = heartbeat.beat.load(std::memory_order_relaxed); beat != last || idle()) {
+            last = beat;
+            progress = now;
+            reported = false;
+        } else if (auto stalled = duration_cast<milliseconds>(now - progress); !reported && stalled >= limit) {
+            reported = true;
+            lock.unlock();
+            publish(sample(stalled, beat));
+            lock.lock();
+        }
+    }
+}
+
+UVCLS_INLINE StallEvent Watchdog::sample(std::chrono::milliseconds duration, std::uint64_t iteration) {
+    StallEvent record{duration, iteration, {}, {}};
+
+#ifdef __linux__
+    using namespace std::chrono;
+    std::lock_guard<std::mutex> lock{internal::Sampler::mutex};
+    auto seq = ++internal::Sampler::sequence;
+    internal::Sampler::requested.store(seq, std::memory_order_release);
+
+    if (::pthread_kill(heartbeat.thread.load(std::memory_order_relaxed), signo) != 0) {
+        internal::Sampler::requested.store(0, std::memory_order_relaxed);
+        return record;
+    }
+
+    // 最多等 100 ms，loop 线程可能屏蔽了这个信号
+    for (auto end = steady_clock::now() + milliseconds{100}; internal::Sampler::answered.load(std::memory_order_acquire) != seq;) {
+        if (auto expected = seq; steady_clock::now() > end && internal::Sampler::requested.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) {
+            // 撤回成功，晚到的信号交给原来的处理函数
+            return record;
+        }
+
+        // 撤回失败说明处理函数已经认领，复制 frames 不会阻塞，等它写完
+        std::this_thread::sleep_for(microseconds{100});
+    }
+
+    auto depth = internal::Sampler::depth;
+    auto symbols = ::backtrace_symbols(internal::Sampler::frames, depth);
+
+    if (!symbols) {
+        return record;
+    }
+
+    // 跳过信号处理函数和内核的信号跳板
+    for (int i = 2; i < depth; ++i) {
+        std::string frame{symbols[i]};
+        auto begin = frame.find('(');
+        auto end = frame.find('+', begin);
+
+        if (begin != std::string::npos && end != std::string::npos && end > begin + 1) {
+            auto mangled = frame.substr(begin + 1, end - begin - 1);
+            int status = 0;
+
+            if (auto name = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status); name) {
+                frame = name;
+                std::free(name);
+            }
+        }
+
+        // 最内层的 Listener<E>::publish 就是正在处理的事件
+        if (auto pos = frame.find(">::Listener<"); record.event.empty() && pos != std::string::npos) {
+            auto from = pos + 12;
+            auto to = frame.find(">::publish", from);
+
+            if (to != std::string::npos) {
+                record.event = frame.substr(from, to - from);
+            }
+        }
+
+        record.frames.push_back(std::move(frame));
+    }
+
+    std::free(symbols);
+#endif
+
+    return record;
+}
+
+}  // namespace uvcls
+
+#endif
@@ -0,0 +1,402 @@
+#ifndef UVCLS_WHEEL_INCLUDE_H
+#define UVCLS_WHEEL_INCLUDE_H
+
+#include <uv.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+
+#include "config.h"
+
+/*
+分层时间轮（hierarchical timing wheel），把大量逻辑定时器复用到 1 个 uv_timer_t 上。
+
+libuv 的定时器是二叉最小堆，每次重新设置定时器都是 O(log n)。连接的超时在每次读写时都会重置，
+1M 个连接就是 1M 个节点的堆。时间轮的插入和取消都是 O(1)：
+
+1. 精度是 1 ms（uv_now 的单位），4 层，每层 64 个槽，最大 64^4 ms（约 4.6 小时），更远的截断到最大值。
+   时间轮直接读 uv_now，它就是 Loop::now 返回的时间。loop.hpp 包含这个文件，所以这里不能反过来依赖 Loop。
+2. 第 0 层的槽在到期时执行，上层的槽在下层转完 1 圈时降级（cascade）到下层。
+3. 每层用 1 个 64 位的位图记录非空的槽，可以直接算出下一次需要唤醒的时间。
+4. 定时器可以声明允许的延迟（slack），到期时间按 internal::coalesce 对齐，窗口重叠的定时器落到同 1 个槽。
+*/
+
+namespace uvcls {
+
+class TimerWheel;
+
+namespace internal {
+
+// 双向循环链表的节点，槽的头节点是哨兵
+struct WheelLink {
+    WheelLink *prev{this};
+    WheelLink *next{this};
+
+    bool linked() const noexcept {
+        return next != this;
+    }
+
+    void unlink() noexcept {
+        prev->next = next;
+        next->prev = prev;
+        prev = next = this;
+    }
+
+    void append(WheelLink &node) noexcept {
+        node.prev = prev;
+        node.next = this;
+        prev->next = &node;
+        prev = &node;
+    }
+};
+
+/*
+定时器的 slack，和 Linux 内核的做法一样：把到期时间推迟到 [expires, expires + slack] 中
+低位连续 0 最多的时刻。窗口重叠的定时器会对齐到同 1 个时刻，loop 只需要唤醒 1 次。
+*/
+inline std::uint64_t coalesce(std::uint64_t expires, std::uint64_t slack) noexcept {
+    if (!slack) {
+        return expires;
+    }
+
+    auto limit = expires + slack;
+    auto bit = 63 - __builtin_clzll(expires ^ limit);
+    return limit & ~((std::uint64_t{1} << bit) - 1);
+}
+
+}  // namespace internal
+
+// 时间轮上的 1 个逻辑定时器，通常直接作为连接对象的成员。重新调度不会申请内存
+class WheelTimer final : private internal::WheelLink {
+    friend class TimerWheel;
+
+   public:
+    using Callback = std::function<void()>;
+
+    WheelTimer() = default;
+
+    explicit WheelTimer(Callback f)
+        : callback{std::move(f)} {}
+
+    WheelTimer(const WheelTimer &) = delete;
+    WheelTimer &operator=(const WheelTimer &) = delete;
+
+    ~WheelTimer() noexcept;
+
+    // 设置到期时执行的函数
+    void on(Callback f);
+
+    bool pending() const noexcept;
+
+    // 到期时间，uv_now 的毫秒数
+    std::uint64_t deadline() const noexcept;
+
+    // 允许推迟执行的毫秒数，下一次 schedule 时生效
+    void slack(std::uint64_t ms) noexcept;
+
+    std::uint64_t slack() const noexcept;
+
+   private:
+    Callback callback{};
+    std::uint64_t window{0};
+    TimerWheel *wheel{nullptr};
+    std::uint64_t expires{0};
+    unsigned int level{0};
+    unsigned int slot{0};
+};
+
+class TimerWheel final {
+    static constexpr unsigned int BITS = 6;
+    static constexpr unsigned int SLOTS = 1u << BITS;
+    static constexpr unsigned int LEVELS = 4;
+    static constexpr std::uint64_t MASK = SLOTS - 1;
+    static constexpr std::uint64_t RANGE = std::uint64_t{1} << (BITS * LEVELS);
+
+    static void timeoutCallback(uv_timer_t *handle);
+
+   public:
+    // 只能在 loop 线程中创建和使用
+    explicit TimerWheel(uv_loop_t *ref);
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    ~TimerWheel() noexcept;
+
+    // timeout 毫秒之后（加上 timer 的 slack）执行 timer 的回调。timer 已经在时间轮上时重新调度
+    void schedule(WheelTimer &timer, std::uint64_t timeout);
+
+    void cancel(WheelTimer &timer) noexcept;
+
+    // 时间轮上的定时器个数
+    std::size_t size() const noexcept;
+
+    // 关闭底层的 uv_timer_t，Loop::close 时调用
+    void close() noexcept;
+
+   private:
+    void insert(WheelTimer &timer) noexcept;
+
+    void remove(WheelTimer &timer) noexcept;
+
+    void cascade(unsigned int level, unsigned int slot) noexcept;
+
+    void advance(std::uint64_t now);
+
+    std::uint64_t next() const noexcept;
+
+    void arm() noexcept;
+
+    uv_loop_t *loop;
+    uv_timer_t timer{};
+    internal::WheelLink slots[LEVELS][SLOTS]{};
+    std::uint64_t occupied[LEVELS]{};
+    // 小于 current 的 tick 都已经处理过
+    std::uint64_t current{0};
+    // uv_timer_t 当前设置的唤醒时间，UINT64_MAX 表示没有设置
+    std::uint64_t armed{UINT64_MAX};
+    std::size_t count{0};
+};
+
+UVCLS_INLINE WheelTimer::~WheelTimer() noexcept {
+    if (wheel) {
+        wheel->cancel(*this);
+    }
+}
+
+UVCLS_INLINE void WheelTimer::on(Callback f) {
+    callback = std::move(f);
+}
+
+UVCLS_INLINE bool WheelTimer::pending() const noexcept {
+    return wheel != nullptr;
+}
+
+UVCLS_INLINE std::uint64_t WheelTimer::deadline() const noexcept {
+    return expires;
+}
+
+UVCLS_INLINE void WheelTimer::slack(std::uint64_t ms) noexcept {
+    window = ms;
+}
+
+UVCLS_INLINE std::uint64_t WheelTimer::slack() const noexcept {
+    return window;
+}
+
+UVCLS_INLINE TimerWheel::TimerWheel(uv_loop_t *ref)
+    : loop{ref} {
+    uv_timer_init(loop, &timer);
+    timer.data = this;
+}
+
+UVCLS_INLINE TimerWheel::~TimerWheel() noexcept {
+    for (auto &level : slots) {
+        for (auto &head : level) {
+            while (head.linked()) {
+                auto &node = static_cast<WheelTimer &>(*head.next);
+                node.unlink();
+                node.wheel = nullptr;
+            }
+        }
+    }
+}
+
+UVCLS_INLINE void TimerWheel::close() noexcept {
+    if (!uv_is_closing(reinterpret_cast<uv_handle_t *>(&timer))) {
+        uv_close(reinterpret_cast<uv_handle_t *>(&timer), nullptr);
+    }
+}
+
+UVCLS_INLINE void TimerWheel::insert(WheelTimer &node) noexcept {
+    if (node.expires < current) {
+        node.expires = current;
+    }
+
+    auto delta = node.expires - current;
+
+    if (delta >= RANGE) {
+        node.expires = current + RANGE - 1;
+        delta = RANGE - 1;
+    }
+
+    unsigned int level = 0;
+
+    while (delta >= (std::uint64_t{1} << (BITS * (level + 1)))) {
+        ++level;
+    }
+
+    node.level = level;
+    node.slot = static_cast<unsigned int>((node.expires >> (BITS * level)) & MASK);
+    slots[level][node.slot].append(node);
+    occupied[level] |= std::uint64_t{1} << node.slot;
+}
+
+UVCLS_INLINE void TimerWheel::remove(WheelTimer &node) noexcept {
+    node.unlink();
+
+    // 槽已经被摘下来执行时，这里的判断仍然成立：只在槽真的为空时清除位图
+    if (!slots[node.level][node.slot].linked()) {
+        occupied[node.level] &= ~(std::uint64_t{1} << node.slot);
+    }
+}
+
+UVCLS_INLINE void TimerWheel::cascade(unsigned int level, unsigned int slot) noexcept {
+    internal::WheelLink list{};
+    auto &head = slots[level][slot];
+
+    while (head.linked()) {
+        auto &node = *head.next;
+        node.unlink();
+        list.append(node);
+    }
+
+    occupied[level] &= ~(std::uint64_t{1} << slot);
+
+    while (list.linked()) {
+        auto &node = static_cast<WheelTimer &>(*list.next);
+        node.unlink();
+        insert(node);
+    }
+}
+
+UVCLS_INLINE void TimerWheel::advance(std::uint64_t now) {
+    while (current <= now && count) {
+        auto tick = current;
+
+        if ((tick & MASK) == 0) {
+            for (unsigned int level = 1; level < LEVELS; ++level) {
+                auto slot = static_cast<unsigned int>((tick >> (BITS * level)) & MASK);
+                cascade(level, slot);
+
+                if (slot != 0) {
+                    break;
+                }
+            }
+        }
+
+        // 先推进 current，回调中新加入的已到期定时器会放到下 1 个 tick
+        current = tick + 1;
+
+        internal::WheelLink list{};
+        auto &head = slots[0][tick & MASK];
+
+        while (head.linked()) {
+            auto &node = *head.next;
+            node.unlink();
+            list.append(node);
+        }
+
+        occupied[0] &= ~(std::uint64_t{1} << (tick & MASK));
+
+        while (list.linked()) {
+            auto &node = static_cast<WheelTimer &>(*list.next);
+            node.unlink();
+            node.wheel = nullptr;
+            count--;
+
+            if (node.callback) {
+                node.callback();
+            }
+        }
+
+        // 第 0 层为空时直接跳到下 1 次降级的位置
+        if (!occupied[0]) {
+            current = std::min(now + 1, (current + MASK) & ~MASK);
+        }
+    }
+
+    if (current <= now) {
+        current = now + 1;
+    }
+}
+
+UVCLS_INLINE std::uint64_t TimerWheel::next() const noexcept {
+    auto result = UINT64_MAX;
+
+    if (occupied[0]) {
+        auto base = static_cast<unsigned int>(current & MASK);
+        auto rotated = (occupied[0] >> base) | (base ? occupied[0] << (SLOTS - base) : 0);
+        result = current + static_cast<std::uint64_t>(__builtin_ctzll(rotated));
+    }
+
+    for (unsigned int level = 1; level < LEVELS; ++level) {
+        if (occupied[level]) {
+            // 上层的槽在下层转完 1 圈、进入这个槽的时刻降级
+            auto index = (current - 1) >> (BITS * level);
+
+            for (std::uint64_t step = 1; step <= SLOTS; ++step) {
+                if (occupied[level] & (std::uint64_t{1} << ((index + step) & MASK))) {
+                    result = std::min(result, (index + step) << (BITS * level));
+                    break;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+UVCLS_INLINE void TimerWheel::arm() noexcept {
+    if (!count) {
+        uv_timer_stop(&timer);
+        armed = UINT64_MAX;
+        return;
+    }
+
+    auto deadline = next();
+    auto now = uv_now(loop);
+    armed = deadline;
+    uv_timer_start(&timer, &timeoutCallback, deadline > now ? deadline - now : 0, 0);
+}
+
+UVCLS_INLINE void TimerWheel::timeoutCallback(uv_timer_t *handle) {
+    TimerWheel &wheel = *(static_cast<TimerWheel *>(handle->data));
+    wheel.armed = UINT64_MAX;
+    wheel.advance(uv_now(wheel.loop));
+    wheel.arm();
+}
+
+UVCLS_INLINE void TimerWheel::schedule(WheelTimer &node, std::uint64_t timeout) {
+    if (node.wheel) {
+        remove(node);
+        count--;
+    }
+
+    auto now = uv_now(loop);
+
+    if (!count) {
+        // 时间轮为空时直接对齐到当前时间，跳过空闲期间的 tick
+        current = std::max(current, now);
+    }
+
+    node.wheel = this;
+    node.expires = internal::coalesce(now + timeout, node.window);
+    insert(node);
+    count++;
+
+    if (node.expires < armed) {
+        arm();
+    }
+}
+
+UVCLS_INLINE void TimerWheel::cancel(WheelTimer &node) noexcept {
+    // 还有其他定时器时不重新设置 uv_timer_t，到期时再计算下一次唤醒的时间
+    if (node.wheel == this) {
+        remove(node);
+        node.wheel = nullptr;
+
+        if (!--count) {
+            arm();
+        }
+    }
+}
+
+UVCLS_INLINE std::size_t TimerWheel::size() const noexcept {
+    return count;
+}
+
+}  // namespace uvcls
+
+#endif
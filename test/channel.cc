@@ -0,0 +1,112 @@
+#include <type_traits>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include "gtest/gtest.h"
+#include "channel.hpp"
+#include "idle.hpp"
+#include "tcp.hpp"
+
+TEST(SPSCQueue, Functionalities) {
+    uvcls::SPSCQueue<int> queue{3};
+    int value = 0;
+
+    // 容量向上取整为 2 的幂
+    ASSERT_EQ(queue.capacity(), 4u);
+    ASSERT_TRUE(queue.empty());
+    ASSERT_FALSE(queue.pop(value));
+
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.push(i));
+    }
+
+    ASSERT_FALSE(queue.push(value));
+    ASSERT_EQ(queue.size(), 4u);
+
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.pop(value));
+        ASSERT_EQ(value, i);
+    }
+
+    ASSERT_TRUE(queue.empty());
+}
+
+// 生产者和消费者在同 1 个 loop 中
+TEST(Channel, Readable) {
+    auto loop = uvcls::Loop::getDefault();
+    auto channel = uvcls::Channel<std::unique_ptr<int>>::create(loop, loop, 8);
+    auto idle = loop->resource<uvcls::IdleHandle>();
+    int readable = 0;
+    int sum = 0;
+
+    channel->receiver().on<uvcls::ReadableEvent>([&](const auto &, auto &rx) {
+        ++readable;
+        rx.drain([&sum](auto &value) { sum += *value; });
+    });
+
+    for (int i = 1; i <= 3; ++i) {
+        ASSERT_TRUE(channel->sender().send(std::make_unique<int>(i)));
+    }
+
+    // 消费者 loop 只会被唤醒 1 次
+    idle->on<uvcls::IdleEvent>([&](const auto &, auto &hndl) {
+        if (sum == 6) {
+            hndl.close();
+        }
+    });
+    idle->start();
+    loop->run();
+
+    ASSERT_EQ(readable, 1);
+    ASSERT_EQ(sum, 6);
+    ASSERT_EQ(channel->size(), 0u);
+}
+
+// 不同线程的两个 loop，队列满之后等待 WritableEvent
+TEST(Channel, Backpressure) {
+    auto producer = uvcls::Loop::create();
+    auto consumer = uvcls::Loop::create();
+    auto channel = uvcls::Channel<int>::create(producer, consumer, 16, 4);
+    constexpr int total = 1000;
+    int next = 0;
+    int received = 0;
+    int writable = 0;
+
+    auto fill = [&next, &producer](auto &tx) {
+        while (next < total && tx.send(next)) {
+            ++next;
+        }
+
+        if (next == total) {
+            producer->keepAlive(false);
+        }
+    };
+
+    channel->sender().on<uvcls::WritableEvent>([&](const auto &, auto &tx) {
+        ++writable;
+        fill(tx);
+    });
+
+    channel->receiver().on<uvcls::ReadableEvent>([&](const auto &, auto &rx) {
+        rx.drain([&received](int value) {
+            ASSERT_EQ(value, received);
+            ++received;
+        });
+
+        if (received == total) {
+            consumer->keepAlive(false);
+        }
+    });
+
+    // 两个 loop 上都只有 post 的 async handle，发送、接收完之前保持运行
+    producer->keepAlive(true);
+    consumer->keepAlive(true);
+    fill(channel->sender());
+
+    std::thread thread{[&consumer]() { consumer->run(); }};
+    producer->run();
+    thread.join();
+
+    ASSERT_EQ(received, total);
+    ASSERT_GT(writable, 0);
+}
@@ -1,9 +1,20 @@
 #include <type_traits>
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
 #include "gtest/gtest.h"
 #include "idle.hpp"
+#include "proxy.hpp"
+#include "sampler.hpp"
 #include "stream.hpp"
 #include "tcp.hpp"
+#include "timer.hpp"
+#include "upstream.hpp"
 
 TEST(Idle, Run) {
     auto loop = uvcls::Loop::getDefault();
@@ -44,3 +55,1008 @@ TEST(TCP, Functionalities) {
     tcp->close();
     loop->run();
 }
+
+// 读缓冲来自 loop 的缓冲池
+TEST(TCP, Options) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto twin = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    bool checked = false;
+
+    server->on<uvcls::ErrorEvent>([](const auto &, auto &) { FAIL(); });
+    twin->on<uvcls::ErrorEvent>([](const auto &, auto &) { FAIL(); });
+    client->on<uvcls::ErrorEvent>([](const auto &, auto &) { FAIL(); });
+
+    // 还没有 socket，bind 时再设置
+    ASSERT_TRUE(server->reusePort(true));
+    ASSERT_TRUE(server->fastOpen(16));
+    ASSERT_TRUE(server->recvBufferSize(1 << 16));
+    ASSERT_EQ(server->fastOpen(), 16);
+    server->bind("127.0.0.1", 0);
+
+    ASSERT_TRUE(server->reusePort());
+    ASSERT_EQ(server->fastOpen(), 16);
+    ASSERT_GE(server->recvBufferSize(), 1 << 16);
+    ASSERT_TRUE(server->deferAccept(uvcls::TCPHandle::Time{1}));
+    ASSERT_GE(server->deferAccept().count(), 1u);
+
+    // 两边都设置了 SO_REUSEPORT 才能绑定同 1 个端口
+    twin->reusePort(true);
+    twin->bind("127.0.0.1", server->sock().port);
+    ASSERT_EQ(twin->sock().port, server->sock().port);
+    twin->close();
+
+    server->on<uvcls::ListenEvent>([](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::DataEvent>([&handle](const auto &, auto &sock) {
+            sock.close();
+            handle.close();
+        });
+        handle.accept(*socket);
+        socket->read();
+    });
+
+    client->fastOpenConnect(true);
+    client->sendBufferSize(1 << 16);
+    client->notSentLowat(16384);
+    client->once<uvcls::ConnectEvent>([&checked](const auto &, auto &hndl) {
+        EXPECT_TRUE(hndl.fastOpenConnect());
+        EXPECT_GE(hndl.sendBufferSize(), 1 << 16);
+        EXPECT_EQ(hndl.notSentLowat(), 16384u);
+        EXPECT_TRUE(hndl.cork(true));
+        EXPECT_TRUE(hndl.cork());
+        EXPECT_TRUE(hndl.cork(false));
+        EXPECT_FALSE(hndl.cork());
+        EXPECT_TRUE(hndl.quickAck(true));
+        EXPECT_TRUE(hndl.quickAck());
+
+        if (hndl.busyPoll(std::chrono::microseconds{50})) {
+            EXPECT_EQ(hndl.busyPoll().count(), 50);
+        }
+
+        checked = true;
+        auto data = std::make_unique<char[]>(1);
+        hndl.write(std::move(data), 1);
+    });
+    client->once<uvcls::WriteEvent>([](const auto &, auto &hndl) {
+        hndl.close();
+    });
+
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+
+    ASSERT_TRUE(checked);
+}
+
+TEST(TCP, OptionsBeforeAccept) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    auto opened = loop->resource<uvcls::TCPHandle>();
+    bool checked = false;
+
+    server->on<uvcls::ErrorEvent>([](const auto &, auto &) { FAIL(); });
+    client->on<uvcls::ErrorEvent>([](const auto &, auto &) { FAIL(); });
+    opened->on<uvcls::ErrorEvent>([](const auto &, auto &) { FAIL(); });
+
+    // open 得到 fd 之后设置
+    ASSERT_TRUE(opened->notSentLowat(8192));
+    opened->open(::socket(AF_INET, SOCK_STREAM, 0));
+    ASSERT_EQ(opened->notSentLowat(), 8192u);
+    opened->close();
+
+    // accept 得到 fd 之后设置
+    server->on<uvcls::ListenEvent>([&checked](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        ASSERT_TRUE(socket->notSentLowat(16384));
+        ASSERT_TRUE(socket->cork(true));
+        handle.accept(*socket);
+
+        EXPECT_EQ(socket->notSentLowat(), 16384u);
+        EXPECT_TRUE(socket->cork());
+        checked = true;
+
+        socket->close();
+        handle.close();
+    });
+
+    client->once<uvcls::ConnectEvent>([](const auto &, auto &hndl) { hndl.close(); });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+
+    ASSERT_TRUE(checked);
+}
+
+TEST(TCP, Info) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    auto sampler = std::make_shared<uvcls::TCPSampler>(loop);
+    uvcls::TCPInfo info{};
+    std::size_t sampled = 0;
+
+    ASSERT_FALSE(client->info().valid);
+
+    sampler->on<uvcls::TCPSampleEvent>([&sampled](const auto &event, auto &) {
+        sampled = event.connections;
+        EXPECT_LE(event.p50, event.p99);
+    });
+
+    server->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::DataEvent>([&](const auto &, auto &sock) {
+            info = client->info();
+            // 监听的 socket 不计入
+            sampler->sample();
+            sock.close();
+            client->close();
+            handle.close();
+        });
+        handle.accept(*socket);
+        socket->read();
+    });
+
+    client->once<uvcls::ConnectEvent>([](const auto &, auto &hndl) {
+        auto data = std::make_unique<char[]>(1);
+        hndl.write(std::move(data), 1);
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+
+    ASSERT_TRUE(info.valid);
+    ASSERT_EQ(info.state, 1u);
+    ASSERT_GT(info.cwnd, 0u);
+    ASSERT_GT(info.rtt.count(), 0);
+    ASSERT_EQ(sampled, 2u);
+    ASSERT_EQ(sampler->latest().connections, 2u);
+}
+
+TEST(TCP, SocketAddress) {
+    uvcls::SocketAddress v4{"127.0.0.1", 80};
+    uvcls::SocketAddress v6{"::1", 80};
+
+    ASSERT_TRUE(v4);
+    ASSERT_TRUE(v6);
+    ASSERT_FALSE((uvcls::SocketAddress{"not an ip", 80}));
+    ASSERT_EQ(v4.family(), AF_INET);
+    ASSERT_EQ(v6.family(), AF_INET6);
+    ASSERT_EQ(v4.str(), "127.0.0.1:80");
+    ASSERT_EQ(v6.str(), "[::1]:80");
+    ASSERT_EQ(v4, (uvcls::SocketAddress{"127.0.0.1", 80}));
+    ASSERT_NE(v4, (uvcls::SocketAddress{"127.0.0.1", 81}));
+    ASSERT_LT(v4, v6);
+
+    std::unordered_set<uvcls::SocketAddress> set{v4, v6, uvcls::SocketAddress{"127.0.0.1", 80}};
+    ASSERT_EQ(set.size(), 2u);
+
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    uvcls::SocketAddress peer;
+    uvcls::SocketAddress local;
+
+    server->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        handle.accept(*socket);
+        peer = socket->remote();
+        local = client->local();
+        // 第 2 次返回缓存的同 1 个对象
+        EXPECT_EQ(&socket->remote(), &socket->remote());
+        socket->close();
+        client->close();
+        handle.close();
+    });
+
+    server->bind(uvcls::SocketAddress{"127.0.0.1", 0});
+    server->listen();
+    client->connect(server->local());
+    loop->run();
+
+    ASSERT_TRUE(peer);
+    ASSERT_EQ(peer, local);
+    ASSERT_EQ(server->local().port(), server->sock().port);
+}
+
+TEST(TCP, ZeroCopy) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    constexpr unsigned int LARGE = 1 << 20;
+    constexpr unsigned int SMALL = 100;
+    std::size_t received = 0;
+    int released = 0;
+    int writes = 0;
+
+    struct Counter {
+        int *count;
+
+        void operator()(char *data) const {
+            ++*count;
+            delete[] data;
+        }
+    };
+
+    server->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::DataEvent>([&](const auto &event, auto &) {
+            received += event.length;
+        });
+        socket->template on<uvcls::EndEvent>([&handle](const auto &, auto &sock) {
+            sock.close();
+            handle.close();
+        });
+        handle.accept(*socket);
+        socket->read();
+    });
+
+    // 还没有 socket，connect 时再设置 SO_ZEROCOPY
+    ASSERT_TRUE(client->zerocopy(64 * 1024));
+    ASSERT_EQ(client->zerocopy(), 0u);
+    client->once<uvcls::ConnectEvent>([&](const auto &, auto &hndl) {
+        // socket 创建之后确认了 SO_ZEROCOPY 才生效
+        ASSERT_EQ(hndl.zerocopy(), 64u * 1024);
+        hndl.write(std::unique_ptr<char[], Counter>{new char[LARGE](), Counter{&released}}, LARGE);
+        hndl.write(std::unique_ptr<char[], Counter>{new char[SMALL](), Counter{&released}}, SMALL);
+        // 大的 buffer 要等到完成通知之后才释放，没有完成的 send 也计入写队列
+        EXPECT_EQ(released, 0);
+        EXPECT_GE(hndl.writeQueueSize(), LARGE);
+    });
+    client->on<uvcls::WriteEvent>([&](const auto &, auto &hndl) {
+        if (++writes == 2) {
+            hndl.close();
+        }
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+
+    auto stats = client->zerocopyStats();
+    ASSERT_EQ(received, LARGE + SMALL);
+    ASSERT_EQ(released, 2);
+    ASSERT_EQ(stats.sends, 1u);
+    ASSERT_EQ(stats.completions, 1u);
+}
+
+// 写完立即 close，完成通知在 handle 关闭之后由 dup 的 fd 上的 PollHandle 读取
+TEST(TCP, ZeroCopyLinger) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    constexpr unsigned int LARGE = 1 << 20;
+    std::size_t received = 0;
+    int released = 0;
+    bool closed = false;
+
+    struct Counter {
+        int *count;
+
+        void operator()(char *data) const {
+            ++*count;
+            delete[] data;
+        }
+    };
+
+    server->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::DataEvent>([&](const auto &event, auto &) {
+            received += event.length;
+        });
+        socket->template on<uvcls::EndEvent>([&handle](const auto &, auto &sock) {
+            sock.close();
+            handle.close();
+        });
+        handle.accept(*socket);
+        socket->read();
+    });
+
+    client->once<uvcls::ConnectEvent>([&](const auto &, auto &hndl) {
+        hndl.zerocopy(64 * 1024);
+        hndl.write(std::unique_ptr<char[], Counter>{new char[LARGE](), Counter{&released}}, LARGE);
+        hndl.close();
+        EXPECT_EQ(released, 0);
+    });
+    client->once<uvcls::CloseEvent>([&closed](const auto &, auto &) { closed = true; });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+
+    ASSERT_TRUE(closed);
+    ASSERT_EQ(received, LARGE);
+    ASSERT_EQ(released, 1);
+    ASSERT_EQ(client->zerocopyStats().completions, 1u);
+}
+
+TEST(TCP, SendFile) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    constexpr std::size_t SIZE = 3 << 20;
+    std::string expected;
+    std::string received;
+    int progress = 0;
+    int done = 0;
+
+    char path[] = "/tmp/uvcls-sendfile-XXXXXX";
+    auto file = ::mkstemp(path);
+    ASSERT_GE(file, 0);
+    ::unlink(path);
+
+    for (std::size_t pos = 0; pos < SIZE; ++pos) {
+        expected.push_back(static_cast<char>(pos * 7 + pos / 251));
+    }
+
+    ASSERT_EQ(::write(file, expected.data(), SIZE), static_cast<ssize_t>(SIZE));
+    // 第 2 次发送文件中间的 1 段，验证顺序和 offset
+    expected += expected.substr(1000, 5000);
+
+    server->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::DataEvent>([&](const auto &event, auto &) {
+            received.append(event.data.get(), event.length);
+        });
+        socket->template on<uvcls::EndEvent>([&handle](const auto &, auto &sock) {
+            sock.close();
+            handle.close();
+        });
+        handle.accept(*socket);
+        socket->read();
+    });
+
+    client->on<uvcls::SendFileProgressEvent>([&progress](const auto &event, auto &) {
+        EXPECT_LE(event.sent, event.length);
+        progress++;
+    });
+    client->on<uvcls::SendFileEvent>([&done](const auto &, auto &hndl) {
+        if (++done == 2) {
+            hndl.close();
+        }
+    });
+    client->once<uvcls::ConnectEvent>([file](const auto &, auto &hndl) {
+        hndl.sendFile(file, 0, SIZE);
+        hndl.sendFile(file, 1000, 5000);
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+    ::close(file);
+
+    ASSERT_EQ(done, 2);
+    ASSERT_GE(progress, 2);
+    ASSERT_EQ(received.size(), expected.size());
+    ASSERT_TRUE(received == expected);
+}
+
+TEST(TCP, Pipe) {
+    auto loop = uvcls::Loop::getDefault();
+    constexpr std::size_t SIZE = 4 << 20;
+    constexpr unsigned int HEADER = 8 << 20;
+    std::string expected;
+
+    for (std::size_t pos = 0; pos < SIZE; ++pos) {
+        expected.push_back(static_cast<char>(pos * 13 + pos / 509));
+    }
+
+    for (auto mode : {uvcls::PipeMode::SPLICE, uvcls::PipeMode::COPY}) {
+        auto front = loop->resource<uvcls::TCPHandle>();
+        auto back = loop->resource<uvcls::TCPHandle>();
+        auto client = loop->resource<uvcls::TCPHandle>();
+        auto outer = loop->resource<uvcls::TCPHandle>();
+        std::shared_ptr<uvcls::TCPHandle> inner;
+        std::shared_ptr<uvcls::TCPHandle> backend;
+        std::string received;
+        std::string reply;
+        std::uint64_t forwarded = 0;
+        int ends = 0;
+
+        // client -> front/inner -> outer -> back/backend，backend 收到 EOF 后回复再关闭写方向
+        back->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+            backend = handle.loop().template resource<uvcls::TCPHandle>();
+            backend->template on<uvcls::DataEvent>([&received](const auto &event, auto &) {
+                received.append(event.data.get(), event.length);
+            });
+            backend->template on<uvcls::EndEvent>([](const auto &, auto &sock) {
+                sock.write(const_cast<char *>("pong"), 4);
+                sock.shutdown();
+            });
+            handle.accept(*backend);
+            backend->read();
+            handle.close();
+        });
+
+        front->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+            inner = handle.loop().template resource<uvcls::TCPHandle>();
+            handle.accept(*inner);
+            handle.close();
+
+            outer->once<uvcls::ConnectEvent>([&](const auto &, auto &hndl) {
+                // 写队列中还有数据时开始转发，转发的数据要排在它们后面
+                auto header = std::unique_ptr<char[]>{new char[HEADER]};
+                std::fill_n(header.get(), HEADER, 'h');
+                hndl.write(std::move(header), HEADER);
+                EXPECT_GT(hndl.writeQueueSize(), 0u);
+
+                for (auto &&pipe : {uvcls::pipe(inner, outer, mode), uvcls::pipe(outer, inner, mode)}) {
+#ifdef __linux__
+                    EXPECT_EQ(pipe->mode(), mode);
+#endif
+
+                    pipe->template on<uvcls::PipeEndEvent>([&](const auto &event, auto &) {
+                        forwarded += event.bytes;
+                        ends++;
+                    });
+                }
+            });
+            outer->connect(back->sock());
+        });
+
+        client->on<uvcls::DataEvent>([&reply](const auto &event, auto &) {
+            reply.append(event.data.get(), event.length);
+        });
+        client->on<uvcls::EndEvent>([&](const auto &, auto &sock) {
+            sock.close();
+            inner->close();
+            outer->close();
+            backend->close();
+        });
+        client->once<uvcls::ConnectEvent>([&expected](const auto &, auto &hndl) {
+            auto data = std::unique_ptr<char[]>{new char[SIZE]};
+            std::copy(expected.begin(), expected.end(), data.get());
+            hndl.write(std::move(data), SIZE);
+            hndl.shutdown();
+            hndl.read();
+        });
+
+        back->bind("127.0.0.1", 0);
+        back->listen();
+        front->bind("127.0.0.1", 0);
+        front->listen();
+        client->connect(front->sock());
+        loop->run();
+
+        ASSERT_EQ(ends, 2);
+        ASSERT_EQ(forwarded, SIZE + 4);
+        ASSERT_EQ(received.size(), HEADER + expected.size());
+        ASSERT_EQ(received.find_first_not_of('h'), HEADER);
+        ASSERT_TRUE(received.compare(HEADER, std::string::npos, expected) == 0);
+        ASSERT_EQ(reply, "pong");
+    }
+}
+
+// COPY 的 pipe 因为背压 stop 了 src，close 之后 src 恢复读
+TEST(TCP, PipeCloseThrottled) {
+    auto loop = uvcls::Loop::getDefault();
+    auto front = loop->resource<uvcls::TCPHandle>();
+    auto back = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    auto outer = loop->resource<uvcls::TCPHandle>();
+    auto timer = loop->resource<uvcls::TimerHandle>();
+    constexpr std::size_t SIZE = 16 << 20;
+    std::shared_ptr<uvcls::TCPHandle> inner;
+    std::shared_ptr<uvcls::TCPHandle> backend;
+    std::shared_ptr<uvcls::StreamPipe<uvcls::TCPHandle, uvcls::TCPHandle>> pipe;
+    std::size_t after = 0;
+    bool ended = false;
+
+    // backend 不读，outer 的写队列超过高水位之后 pipe stop 了 inner
+    back->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        backend = handle.loop().template resource<uvcls::TCPHandle>();
+        handle.accept(*backend);
+        handle.close();
+    });
+
+    front->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        inner = handle.loop().template resource<uvcls::TCPHandle>();
+        handle.accept(*inner);
+        handle.close();
+
+        outer->once<uvcls::ConnectEvent>([&](const auto &, auto &) {
+            pipe = uvcls::pipe(inner, outer, uvcls::PipeMode::COPY);
+            timer->start(uvcls::TimerHandle::Time{10}, uvcls::TimerHandle::Time{10});
+        });
+        outer->connect(back->sock());
+    });
+
+    timer->on<uvcls::TimerEvent>([&](const auto &, auto &hndl) {
+        if (outer->writeQueueSize() <= decltype(pipe)::element_type::HIGH_WATERMARK) {
+            return;
+        }
+
+        hndl.close();
+        pipe->close();
+        inner->on<uvcls::DataEvent>([&after](const auto &event, auto &) { after += event.length; });
+        inner->on<uvcls::EndEvent>([&](const auto &, auto &sock) {
+            ended = true;
+            sock.close();
+            client->close();
+            outer->close();
+            backend->close();
+        });
+    });
+
+    client->once<uvcls::ConnectEvent>([](const auto &, auto &hndl) {
+        auto data = std::unique_ptr<char[]>{new char[SIZE]()};
+        hndl.write(std::move(data), SIZE);
+        hndl.shutdown();
+    });
+
+    back->bind("127.0.0.1", 0);
+    back->listen();
+    front->bind("127.0.0.1", 0);
+    front->listen();
+    client->connect(front->sock());
+    loop->run();
+
+    ASSERT_TRUE(ended);
+    ASSERT_GT(after, 0u);
+}
+
+TEST(TCP, ReadWrite) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    std::string received;
+
+    server->once<uvcls::ListenEvent>([&received](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::DataEvent>([&received](const auto &event, auto &) {
+            received.append(event.data.get(), event.length);
+        });
+        socket->template on<uvcls::EndEvent>([&handle](const auto &, auto &sock) {
+            sock.close();
+            handle.close();
+        });
+        handle.accept(*socket);
+        socket->read();
+    });
+
+    client->once<uvcls::ConnectEvent>([](const auto &, auto &hndl) {
+        hndl.write(const_cast<char *>("hello"), 5);
+    });
+    client->once<uvcls::WriteEvent>([](const auto &, auto &hndl) {
+        hndl.close();
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+
+    ASSERT_EQ(received, "hello");
+    ASSERT_GT(loop->buffers().capacity(), 0u);
+}
+
+// 空闲的连接超时，有数据的连接不超时
+TEST(TCP, Timeout) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    auto ticker = loop->resource<uvcls::TimerHandle>();
+    std::vector<uvcls::TimeoutEvent::Type> timeouts;
+    std::size_t received = 0;
+
+    server->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::DataEvent>([&received](const auto &event, auto &) { received += event.length; });
+        socket->template on<uvcls::TimeoutEvent>([&](const auto &event, auto &sock) {
+            timeouts.push_back(event.type);
+            sock.close();
+            handle.close();
+            client->close();
+        });
+        handle.accept(*socket);
+        // 写的间隔是 10 ms，超时留 10 倍的余量，负载高的机器上调度延迟也不会提前超时
+        socket->timeout(uvcls::TimeoutEvent::Type::READ, std::chrono::milliseconds{100});
+        socket->read();
+    });
+
+    // 前 5 次每隔 10 ms 写 1 次，之后停止写
+    ticker->on<uvcls::TimerEvent>([&client, writes = 0](const auto &, auto &hndl) mutable {
+        client->write(const_cast<char *>("ping"), 4);
+
+        if (++writes == 5) {
+            hndl.close();
+        }
+    });
+
+    client->once<uvcls::ConnectEvent>([&ticker](const auto &, auto &) {
+        ticker->start(uvcls::TimerHandle::Time{10}, uvcls::TimerHandle::Time{10});
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+
+    ASSERT_EQ(received, 20u);
+    ASSERT_EQ(timeouts, (std::vector<uvcls::TimeoutEvent::Type>{uvcls::TimeoutEvent::Type::READ}));
+}
+
+// 每轮最多读 1 次，大量数据分多轮读完。打开接收时间戳、自己读 fd 时也一样
+TEST(TCP, ReadBudget) {
+    auto loop = uvcls::Loop::getDefault();
+    constexpr unsigned int SIZE = 1 << 20;
+
+    for (bool stamped : {false, true}) {
+        auto server = loop->resource<uvcls::TCPHandle>();
+        auto client = loop->resource<uvcls::TCPHandle>();
+        std::unique_ptr<char[]> payload{new char[SIZE]};
+        std::size_t received = 0;
+        std::size_t maxReads = 0;
+        std::uint64_t iteration = 0;
+        std::size_t reads = 0;
+
+        server->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+            auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+            socket->budget(uvcls::ReadBudget{0, 1});
+            socket->template on<uvcls::DataEvent>([&](const auto &event, auto &sock) {
+                if (auto now = sock.loop().iteration(); now != iteration) {
+                    iteration = now;
+                    reads = 0;
+                }
+
+                maxReads = std::max(maxReads, ++reads);
+                received += event.length;
+            });
+            socket->template on<uvcls::EndEvent>([&handle](const auto &, auto &sock) {
+                sock.close();
+                handle.close();
+            });
+            handle.accept(*socket);
+
+            if (stamped) {
+                ASSERT_TRUE(socket->timestamping(true));
+            }
+
+            socket->read();
+        });
+
+        client->once<uvcls::ConnectEvent>([&payload](const auto &, auto &hndl) {
+            hndl.write(std::move(payload), SIZE);
+        });
+        client->once<uvcls::WriteEvent>([](const auto &, auto &hndl) {
+            hndl.close();
+        });
+
+        server->bind("127.0.0.1", 0);
+        server->listen();
+        client->connect(server->sock());
+        loop->run();
+
+        ASSERT_EQ(received, SIZE);
+        ASSERT_EQ(maxReads, 1u);
+    }
+}
+
+TEST(TCP, BatchAccept) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    constexpr int CLIENTS = 8;
+    std::vector<int> clients;
+    std::vector<std::shared_ptr<uvcls::TCPHandle>> accepted;
+    int events = 0;
+    int prepared = 0;
+
+    server->batch(16, [&prepared](uvcls::TCPHandle &handle) {
+        handle.noDelay(true);
+        prepared++;
+    });
+    server->on<uvcls::ListenEvent>([](const auto &, auto &) {
+        FAIL();
+    });
+    server->on<uvcls::AcceptedEvent<uvcls::TCPHandle>>([&](const auto &event, auto &handle) {
+        events++;
+        accepted.insert(accepted.end(), event.begin(), event.end());
+
+        if (accepted.size() == CLIENTS) {
+            for (auto &sock : accepted) {
+                sock->close();
+            }
+
+            handle.close();
+        }
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+
+    // 阻塞的 connect 返回时连接已经在 accept 队列中，第 1 次可读事件就能全部取走
+    for (int i = 0; i < CLIENTS; ++i) {
+        auto addr = server->sock();
+        sockaddr_in sa{};
+        uv_ip4_addr(addr.ip.c_str(), static_cast<int>(addr.port), &sa);
+        auto fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(::connect(fd, reinterpret_cast<const sockaddr *>(&sa), sizeof(sa)), 0);
+        clients.push_back(fd);
+    }
+
+    loop->run();
+
+    for (auto fd : clients) {
+        ::close(fd);
+    }
+
+    ASSERT_EQ(accepted.size(), static_cast<std::size_t>(CLIENTS));
+    ASSERT_EQ(prepared, CLIENTS);
+    ASSERT_EQ(events, 1);
+}
+
+TEST(TCP, AdmissionPause) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    std::vector<int> clients;
+    std::vector<std::shared_ptr<uvcls::TCPHandle>> accepted;
+    bool paused = false;
+    std::size_t held = 0;
+
+    server->admission(uvcls::AdmissionPolicy{2});
+    server->on<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        // 恢复之后交出 libuv 保留的连接时也不会超过上限
+        ASSERT_LT(server->stats().active, 2u);
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        handle.accept(*socket);
+        accepted.push_back(socket);
+
+        if (accepted.size() == 2) {
+            // 第 3 个连接在同 1 次可读事件中被暂停，关闭 1 个连接之后恢复
+            handle.loop().defer([&]() {
+                paused = server->stats().paused;
+                held = server->stats().held;
+                accepted.front()->close();
+            });
+        } else if (accepted.size() == 3) {
+            for (auto &sock : accepted) {
+                sock->close();
+            }
+
+            handle.close();
+        }
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+
+    for (int i = 0; i < 3; ++i) {
+        auto addr = server->sock();
+        sockaddr_in sa{};
+        uv_ip4_addr(addr.ip.c_str(), static_cast<int>(addr.port), &sa);
+        auto fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(::connect(fd, reinterpret_cast<const sockaddr *>(&sa), sizeof(sa)), 0);
+        clients.push_back(fd);
+    }
+
+    loop->run();
+
+    for (auto fd : clients) {
+        ::close(fd);
+    }
+
+    auto stats = server->stats();
+    ASSERT_TRUE(paused);
+    ASSERT_EQ(held, 1u);
+    ASSERT_EQ(stats.held, 0u);
+    ASSERT_EQ(accepted.size(), 3u);
+    ASSERT_EQ(stats.accepted, 3u);
+    ASSERT_EQ(stats.shed, 0u);
+    ASSERT_EQ(stats.active, 0u);
+}
+
+TEST(TCP, AdmissionReset) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    std::vector<int> clients;
+    std::shared_ptr<uvcls::TCPHandle> accepted;
+
+    server->admission(uvcls::AdmissionPolicy{1, std::chrono::milliseconds{0}, uvcls::AdmissionPolicy::Action::RESET});
+    server->on<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        accepted = handle.loop().template resource<uvcls::TCPHandle>();
+        handle.accept(*accepted);
+        handle.loop().defer([&]() {
+            accepted->close();
+            server->close();
+        });
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+
+    for (int i = 0; i < 2; ++i) {
+        auto addr = server->sock();
+        sockaddr_in sa{};
+        uv_ip4_addr(addr.ip.c_str(), static_cast<int>(addr.port), &sa);
+        auto fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(::connect(fd, reinterpret_cast<const sockaddr *>(&sa), sizeof(sa)), 0);
+        clients.push_back(fd);
+    }
+
+    loop->run();
+
+    // 被拒绝的连接收到 RST
+    char byte;
+    ASSERT_EQ(::recv(clients[1], &byte, 1, 0), -1);
+    ASSERT_EQ(errno, ECONNRESET);
+
+    for (auto fd : clients) {
+        ::close(fd);
+    }
+
+    auto stats = server->stats();
+    ASSERT_EQ(stats.accepted, 1u);
+    ASSERT_EQ(stats.shed, 1u);
+}
+
+TEST(TCP, ConnectionPool) {
+    using namespace std::chrono_literals;
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto timer = loop->resource<uvcls::TimerHandle>();
+    auto pool = std::make_shared<uvcls::ConnectionPool>(loop, uvcls::PoolPolicy{2, 2, 0, 200ms, false});
+    std::vector<std::shared_ptr<uvcls::TCPHandle>> accepted;
+    std::shared_ptr<uvcls::TCPHandle> first, second, third;
+    int ticks = 0;
+
+    server->on<uvcls::ListenEvent>([&accepted](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::EndEvent>([](const auto &, auto &sock) { sock.close(); });
+        handle.accept(*socket);
+        socket->read();
+        accepted.push_back(socket);
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    uvcls::SocketAddress key{"127.0.0.1", server->sock().port};
+
+    pool->checkout(key, [&](auto handle, int status) {
+        ASSERT_EQ(status, 0);
+        first = handle;
+
+        pool->checkout(key, [&](auto handle, int) {
+            second = handle;
+            // 达到 total，排队直到有连接归还
+            pool->checkout(key, [&third](auto handle, int) { third = handle; });
+            ASSERT_EQ(third, nullptr);
+            pool->checkin(first);
+            ASSERT_EQ(third, first);
+            pool->checkin(third);
+            pool->checkin(second);
+            ASSERT_EQ(pool->idle(key), 2u);
+        });
+    });
+
+    timer->on<uvcls::TimerEvent>([&](const auto &, auto &handle) {
+        switch (++ticks) {
+        case 2:
+            // 服务端关闭 1 个连接，空闲的客户端读到 EOF
+            ASSERT_EQ(accepted.size(), 2u);
+            accepted.front()->close();
+            break;
+        case 5:
+            ASSERT_EQ(pool->stats().broken, 1u);
+            ASSERT_EQ(pool->idle(key), 1u);
+            ASSERT_EQ(pool->total(key), 1u);
+            break;
+        case 20:
+            // 剩下的连接空闲超过 200 ms
+            ASSERT_EQ(pool->stats().evicted, 1u);
+            ASSERT_EQ(pool->total(key), 0u);
+            pool->policy(uvcls::PoolPolicy{2, 2, 1, 200ms, false});
+            pool->warm(key);
+            break;
+        case 24:
+            ASSERT_EQ(pool->idle(key), 1u);
+            ASSERT_EQ(pool->stats().created, 3u);
+            ASSERT_EQ(pool->stats().reused, 1u);
+            pool->close();
+            server->close();
+            handle.close();
+            break;
+        }
+    });
+
+    timer->start(uvcls::TimerHandle::Time{20}, uvcls::TimerHandle::Time{20});
+    loop->run();
+
+    ASSERT_EQ(ticks, 24);
+    ASSERT_EQ(pool->stats().total, 0u);
+}
+
+TEST(TCP, Timestamping) {
+    auto loop = uvcls::Loop::getDefault();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    auto timer = loop->resource<uvcls::TimerHandle>();
+    auto histogram = std::make_shared<uvcls::LatencyHistogram>();
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    std::uint64_t stamped = 0;
+    std::size_t plain = 0;
+
+    server->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        auto socket = handle.loop().template resource<uvcls::TCPHandle>();
+        socket->template on<uvcls::DataEvent>([&](const auto &event, auto &sock) {
+            received += event.length;
+
+            // 关闭时间戳之后换回 libuv 继续读
+            if (!sock.timestamping()) {
+                plain += event.length;
+                sock.close();
+            } else if (event.timestamp.count() > 0 && ++stamped == 1) {
+                ASSERT_TRUE(sock.timestamping(false));
+                ASSERT_EQ(sock.latency(), nullptr);
+            }
+        });
+        handle.accept(*socket);
+        ASSERT_TRUE(socket->timestamping(true, histogram));
+        ASSERT_EQ(socket->latency(), histogram);
+        // 通过 StreamHandle 的引用调用也会分发到 TCPHandle 自己读 fd 的路径
+        uvcls::StreamHandle<uvcls::TCPHandle, uv_tcp_t> &stream = *socket;
+        stream.read();
+        handle.close();
+    });
+
+    // 内核在第 1 个打开时间戳的 socket 之后异步地开始给收到的包打时间戳，最初的几个包可能没有
+    timer->on<uvcls::TimerEvent>([&](const auto &, auto &handle) {
+        if (plain || ++sent > 200) {
+            handle.close();
+            client->close();
+        } else {
+            client->write(const_cast<char *>("x"), 1);
+        }
+    });
+
+    client->once<uvcls::ConnectEvent>([&timer](const auto &, auto &) {
+        timer->start(uvcls::TimerHandle::Time{0}, uvcls::TimerHandle::Time{5});
+    });
+
+    ASSERT_TRUE(server->timestamping(true));
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+
+    ASSERT_EQ(stamped, 1u);
+    ASSERT_GE(plain, 1u);
+    ASSERT_GE(received, 2u);
+    ASSERT_EQ(histogram->count(), stamped);
+    ASSERT_LT(histogram->percentile(0.99), std::chrono::seconds{1});
+}
+
+TEST(Histogram, Percentile) {
+    uvcls::LatencyHistogram histogram;
+    ASSERT_EQ(histogram.percentile(0.5).count(), 0);
+
+    for (int us = 1; us <= 1000; ++us) {
+        histogram.record(std::chrono::microseconds{us});
+    }
+
+    // 桶的相对误差不超过 1 / 8
+    auto p50 = std::chrono::duration<double, std::micro>{histogram.percentile(0.5)}.count();
+    auto p99 = std::chrono::duration<double, std::micro>{histogram.percentile(0.99)}.count();
+    ASSERT_GE(p50, 500.0);
+    ASSERT_LE(p50, 500.0 * 1.125);
+    ASSERT_GE(p99, 990.0);
+    ASSERT_LE(p99, 1000.0);
+    ASSERT_EQ(histogram.percentile(1.0), std::chrono::microseconds{1000});
+    ASSERT_EQ(histogram.count(), 1000u);
+    ASSERT_EQ(histogram.max(), std::chrono::microseconds{1000});
+
+    histogram.record(std::chrono::nanoseconds{3});
+    ASSERT_EQ(histogram.percentile(0.0), std::chrono::nanoseconds{3});
+
+    histogram.reset();
+    ASSERT_EQ(histogram.count(), 0u);
+}
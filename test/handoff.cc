@@ -0,0 +1,298 @@
+#include <type_traits>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include "gtest/gtest.h"
+#include "handoff.hpp"
+#include "idle.hpp"
+
+// acceptor 在默认 loop 上 accept，worker loop 在 async 回调中接管 fd
+TEST(Handoff, RoundRobin) {
+    auto loop = uvcls::Loop::getDefault();
+    auto worker = uvcls::Loop::create();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    auto handoff = worker->resource<uvcls::HandoffHandle>();
+    auto acceptor = std::make_shared<uvcls::Acceptor>(server);
+    bool adopted = false;
+
+    handoff->on<uvcls::HandoffEvent>([&adopted](auto &event, auto &hndl) {
+        ASSERT_EQ(hndl.active(), 1u);
+        adopted = true;
+        event.handle->close();
+        hndl.close();
+    });
+
+    client->once<uvcls::ConnectEvent>([&server](const auto &, auto &hndl) {
+        hndl.close();
+        server->close();
+    });
+
+    server->bind("127.0.0.1", 0);
+    acceptor->add(handoff);
+    acceptor->listen();
+    client->connect(server->sock());
+
+    loop->run();
+    ASSERT_EQ(handoff->active(), 1u);
+
+    std::thread thread{[&worker]() { worker->run(); }};
+    thread.join();
+
+    ASSERT_TRUE(adopted);
+    ASSERT_EQ(handoff->active(), 0u);
+}
+
+TEST(Handoff, LeastConnections) {
+    auto loop = uvcls::Loop::getDefault();
+    auto worker = uvcls::Loop::create();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto acceptor = std::make_shared<uvcls::Acceptor>(server, uvcls::Balance::LEAST_CONNECTIONS);
+    auto busy = worker->resource<uvcls::HandoffHandle>();
+    auto idle = worker->resource<uvcls::HandoffHandle>();
+    std::size_t connections = 0;
+
+    auto adopt = [&connections](auto &event, auto &) {
+        ++connections;
+        event.handle->close();
+    };
+
+    busy->on<uvcls::HandoffEvent>(adopt);
+    idle->on<uvcls::HandoffEvent>(adopt);
+
+    // 批量 accept 时 acceptor 处理 AcceptedEvent
+    server->bind("127.0.0.1", 0);
+    server->batch(8);
+    acceptor->add(busy);
+    acceptor->add(idle);
+    acceptor->listen();
+
+    for (int i = 0; i < 3; ++i) {
+        auto client = loop->resource<uvcls::TCPHandle>();
+        client->once<uvcls::ConnectEvent>([](const auto &, auto &hndl) { hndl.close(); });
+        client->connect(server->sock());
+    }
+
+    // 3 个连接都还没有被 worker 接管，计数应该尽量平均
+    auto check = loop->resource<uvcls::IdleHandle>();
+    check->on<uvcls::IdleEvent>([&](const auto &, auto &hndl) {
+        if (busy->active() + idle->active() == 3) {
+            hndl.close();
+            server->close();
+        }
+    });
+    check->start();
+    loop->run();
+
+    ASSERT_EQ(busy->active(), 2u);
+    ASSERT_EQ(idle->active(), 1u);
+
+    worker->run<uvcls::UVRunMode::NOWAIT>();
+    busy->close();
+    idle->close();
+    worker->run();
+    ASSERT_EQ(connections, 3u);
+}
+
+// 关闭时还在队列中的 fd 直接关闭
+TEST(Handoff, CloseQueued) {
+    auto worker = uvcls::Loop::create();
+    auto handoff = worker->resource<uvcls::HandoffHandle>();
+    auto sock = ::socket(AF_INET, SOCK_STREAM, 0);
+    bool adopted = false;
+
+    handoff->on<uvcls::HandoffEvent>([&adopted](auto &event, auto &) {
+        adopted = true;
+        event.handle->close();
+    });
+
+    handoff->push(sock);
+    ASSERT_EQ(handoff->active(), 1u);
+    // 通过基类关闭也要清理队列
+    static_cast<uvcls::Handle<uvcls::HandoffHandle, uv_async_t> &>(*handoff).close();
+    ASSERT_EQ(::fcntl(sock, F_GETFD), -1);
+
+    // 关闭之后 push 的 fd 直接关闭，不再唤醒 worker
+    auto late = ::socket(AF_INET, SOCK_STREAM, 0);
+    handoff->push(late);
+    worker->run();
+
+    ASSERT_FALSE(adopted);
+    ASSERT_EQ(handoff->active(), 0u);
+    ASSERT_EQ(::fcntl(late, F_GETFD), -1);
+}
+
+// 迁移时先写完写队列，没有读的数据和 context 一起转移到新的 worker
+TEST(Handoff, Migrate) {
+    auto loop = uvcls::Loop::getDefault();
+    auto worker = uvcls::Loop::create();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    auto handoff = worker->resource<uvcls::HandoffHandle>();
+    auto context = std::make_shared<int>(42);
+    constexpr unsigned int SIZE = 1 << 20;
+    std::size_t received = 0;
+    bool migrated = false;
+    std::string moved;
+
+    server->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        auto sock = handle.loop().template resource<uvcls::TCPHandle>();
+        sock->template once<uvcls::CloseEvent>([&migrated](const auto &, auto &) { migrated = true; });
+        handle.accept(*sock);
+        sock->write(std::unique_ptr<char[]>{new char[SIZE]}, SIZE);
+        handoff->migrate(sock, context);
+    });
+
+    client->once<uvcls::ConnectEvent>([](const auto &, auto &hndl) {
+        hndl.write(const_cast<char *>("hello"), 5);
+        hndl.read();
+    });
+    client->on<uvcls::DataEvent>([&](const auto &event, auto &hndl) {
+        if ((received += event.length) == SIZE) {
+            hndl.close();
+            server->close();
+        }
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+
+    ASSERT_EQ(received, SIZE);
+    ASSERT_TRUE(migrated);
+    ASSERT_EQ(handoff->active(), 1u);
+
+    handoff->on<uvcls::HandoffEvent>([&](auto &event, auto &) {
+        ASSERT_EQ(event.context, context);
+        event.handle->template on<uvcls::DataEvent>([&moved](const auto &data, auto &) {
+            moved.append(data.data.get(), data.length);
+        });
+        event.handle->template on<uvcls::EndEvent>([&handoff](const auto &, auto &hndl) {
+            hndl.close();
+            handoff->close();
+        });
+        event.handle->read();
+    });
+
+    std::thread thread{[&worker]() { worker->run(); }};
+    thread.join();
+
+    ASSERT_EQ(moved, "hello");
+}
+
+// 等待写队列清空时写失败，连接被关闭，不会一直停在迁移中
+TEST(Handoff, MigrateWriteError) {
+    auto loop = uvcls::Loop::getDefault();
+    auto worker = uvcls::Loop::create();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    auto client = loop->resource<uvcls::TCPHandle>();
+    auto handoff = worker->resource<uvcls::HandoffHandle>();
+    constexpr unsigned int SIZE = 64 << 20;
+    bool closed = false;
+    int error = 0;
+
+    handoff->on<uvcls::ErrorEvent>([&error](const auto &event, auto &) { error = event.code(); });
+
+    server->once<uvcls::ListenEvent>([&](const auto &, auto &handle) {
+        auto sock = handle.loop().template resource<uvcls::TCPHandle>();
+        sock->template once<uvcls::CloseEvent>([&closed](const auto &, auto &) { closed = true; });
+        handle.accept(*sock);
+        sock->write(std::unique_ptr<char[]>{new char[SIZE]}, SIZE);
+        ASSERT_GT(sock->writeQueueSize(), 0u);
+        handoff->migrate(sock);
+
+        // 对端不读，直接 RST
+        client->closeReset();
+        handle.close();
+    });
+
+    server->bind("127.0.0.1", 0);
+    server->listen();
+    client->connect(server->sock());
+    loop->run();
+
+    ASSERT_TRUE(closed);
+    ASSERT_NE(error, 0);
+    ASSERT_EQ(handoff->active(), 0u);
+    handoff->close();
+    worker->run();
+}
+
+// 延迟高的 worker 把连接迁移给延迟低的 worker
+TEST(Handoff, Rebalance) {
+    auto loop = uvcls::Loop::getDefault();
+    auto slow = uvcls::Loop::create();
+    auto fast = uvcls::Loop::create();
+    auto from = slow->resource<uvcls::HandoffHandle>();
+    auto to = fast->resource<uvcls::HandoffHandle>();
+    auto busy = slow->resource<uvcls::TimerHandle>();
+    auto rebalancer = std::make_shared<uvcls::Rebalancer>(loop, std::chrono::milliseconds{2}, 2);
+    std::atomic<bool> adopted{false};
+    std::shared_ptr<void> context{nullptr};
+    std::vector<std::shared_ptr<uvcls::TCPHandle>> adoptions;
+    std::vector<uvcls::RebalanceEvent> decisions;
+
+    // slow 上的定时器每次阻塞 loop 10 ms
+    busy->on<uvcls::TimerEvent>([](const auto &, auto &) {
+        for (auto end = uv_hrtime() + 10000000; uv_hrtime() < end;) {
+        }
+    });
+    busy->start(uvcls::TimerHandle::Time{1}, uvcls::TimerHandle::Time{1});
+
+    // 第 1 个连接被否决，第 2 个连接带着 context 迁移
+    from->on<uvcls::HandoffEvent>([&adoptions](auto &event, auto &) { adoptions.push_back(event.handle); });
+    from->on<uvcls::MigrateEvent>([vetoed = false](auto &event, auto &) mutable {
+        event.veto = !std::exchange(vetoed, true);
+        event.context = std::make_shared<int>(42);
+    });
+    from->push(::socket(AF_INET, SOCK_STREAM, 0));
+    from->push(::socket(AF_INET, SOCK_STREAM, 0));
+    from->probe(std::chrono::milliseconds{5});
+
+    to->on<uvcls::HandoffEvent>([&adopted, &context](auto &event, auto &) {
+        event.handle->close();
+        context = event.context;
+        adopted = true;
+    });
+    to->probe(std::chrono::milliseconds{5});
+
+    rebalancer->on<uvcls::RebalanceEvent>([&decisions](auto &event, auto &ref) {
+        decisions.push_back(event);
+        ref.stop();
+    });
+    rebalancer->add(from);
+    rebalancer->add(to);
+    rebalancer->start(std::chrono::milliseconds{50});
+
+    std::thread slowThread{[&slow]() { slow->run(); }};
+    std::thread fastThread{[&fast]() { fast->run(); }};
+    loop->run();
+
+    for (int i = 0; i < 1000 && !adopted; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+
+    slow->post([&]() {
+        busy->close();
+        from->close();
+
+        for (auto &handle : adoptions) {
+            handle->close();
+        }
+    });
+    fast->post([&]() { to->close(); });
+    slowThread.join();
+    fastThread.join();
+
+    ASSERT_EQ(decisions.size(), 1u);
+    ASSERT_EQ(decisions[0].from, 0u);
+    ASSERT_EQ(decisions[0].to, 1u);
+    ASSERT_TRUE(adopted);
+    ASSERT_NE(context, nullptr);
+    ASSERT_EQ(*std::static_pointer_cast<int>(context), 42);
+    ASSERT_EQ(from->active(), 0u);
+}
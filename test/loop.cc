@@ -1,10 +1,504 @@
 #include <type_traits>
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <signal.h>
 #include "gtest/gtest.h"
 #include "loop.hpp"
+#include "idle.hpp"
+#include "tcp.hpp"
+#include "timer.hpp"
 
 // ErrorEvent 事件用于封装 uv 的 error 事件
 TEST(Loop, Run) {
     auto loop = uvcls::Loop::getDefault();
     loop->run();
-}
\ No newline at end of file
+}
+TEST(Loop, Post) {
+    auto loop = uvcls::Loop::create();
+    constexpr int producers = 4;
+    constexpr int tasks = 10000;
+    int count = 0;
+
+    // loop 上没有其他 handle，只等待 post 的任务，最后 1 个任务让 run 返回
+    loop->keepAlive(true);
+
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < producers; ++i) {
+        threads.emplace_back([&loop, &count]() {
+            for (int j = 0; j < tasks; ++j) {
+                loop->post([&loop, &count]() {
+                    if (++count == producers * tasks) {
+                        loop->keepAlive(false);
+                    }
+                });
+            }
+        });
+    }
+
+    loop->run();
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(count, producers * tasks);
+}
+
+// 还有 handle 时 close 失败，不执行回调，post 仍然可用
+TEST(Loop, Close) {
+    auto loop = uvcls::Loop::create();
+    auto idle = loop->resource<uvcls::IdleHandle>();
+    int error = 0;
+    bool posted = false;
+    bool closed = false;
+
+    loop->on<uvcls::ErrorEvent>([&error](const auto &event, auto &) { error = event.code(); });
+    idle->on<uvcls::CloseEvent>([&closed](const auto &, auto &) { closed = true; });
+    idle->close();
+
+    loop->close();
+    ASSERT_EQ(error, UV_EBUSY);
+    ASSERT_FALSE(closed);
+
+    loop->post([&posted]() { posted = true; });
+    loop->run();
+    ASSERT_TRUE(posted);
+    ASSERT_TRUE(closed);
+
+    error = 0;
+    loop->close();
+    ASSERT_EQ(error, 0);
+}
+
+// 析构时还有 handle：loop 自己的 handle 要关闭并且不随 Loop 释放，之后还能继续运行 uv_loop_t
+TEST(Loop, DestroyBusy) {
+    auto loop = uvcls::Loop::create();
+    auto raw = loop->raw();
+    auto timer = new uv_timer_t{};
+    int error = 0;
+
+    loop->on<uvcls::ErrorEvent>([&error](const auto &event, auto &) { error = event.code(); });
+    uv_timer_init(raw, timer);
+    loop = nullptr;
+    ASSERT_EQ(error, UV_EBUSY);
+
+    uv_close(reinterpret_cast<uv_handle_t *>(timer), [](uv_handle_t *handle) { delete reinterpret_cast<uv_timer_t *>(handle); });
+    uv_run(raw, UV_RUN_DEFAULT);
+    ASSERT_EQ(uv_loop_close(raw), 0);
+    delete raw;
+}
+
+TEST(MPSCQueue, Order) {
+    uvcls::MPSCQueue<int> queue{};
+
+    ASSERT_TRUE(queue.empty());
+    ASSERT_TRUE(queue.push(1));
+    ASSERT_FALSE(queue.push(2));
+    ASSERT_FALSE(queue.push(3));
+
+    std::vector<int> values;
+    ASSERT_EQ(queue.consume([&values](int value) { values.push_back(value); }), 3u);
+    ASSERT_EQ(values, (std::vector<int>{1, 2, 3}));
+    ASSERT_TRUE(queue.empty());
+    ASSERT_TRUE(queue.push(4));
+}
+
+// 空闲时退避到阻塞的 epoll_wait，被其他线程的 post 唤醒
+TEST(Loop, Spin) {
+    auto loop = uvcls::Loop::create();
+    auto server = loop->resource<uvcls::TCPHandle>();
+    int iterations = 0;
+
+    loop->spin(uvcls::SpinBudget{std::chrono::microseconds{10}, std::chrono::microseconds{20}, std::chrono::microseconds{50}});
+    server->bind("127.0.0.1", 0);
+    server->listen();
+
+    std::thread thread{[&loop, &server]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+        loop->post([&loop, &server]() {
+            server->close();
+            loop->stop();
+        });
+    }};
+
+    auto idle = loop->resource<uvcls::IdleHandle>();
+    idle->on<uvcls::IdleEvent>([&iterations](const auto &, auto &hndl) {
+        if (++iterations == 100) {
+            hndl.close();
+        }
+    });
+    idle->start();
+
+    loop->run<uvcls::UVRunMode::SPIN>();
+    thread.join();
+
+    ASSERT_EQ(iterations, 100);
+    ASSERT_TRUE(server->closing());
+}
+
+// 退避期间定时器也要按时触发，不能等到阻塞的 epoll_wait
+TEST(Loop, SpinTimer) {
+    auto loop = uvcls::Loop::create();
+    auto timer = loop->resource<uvcls::TimerHandle>();
+    std::uint64_t fired = 0;
+
+    // yield 阶段很长，退回 epoll_wait 之前定时器就该到期了
+    loop->spin(uvcls::SpinBudget{std::chrono::microseconds{10}, std::chrono::microseconds{20}, std::chrono::seconds{10}});
+    timer->on<uvcls::TimerEvent>([&fired](const auto &, auto &hndl) {
+        fired = uv_hrtime();
+        hndl.close();
+    });
+
+    auto begin = uv_hrtime();
+    timer->start(uvcls::TimerHandle::Time{2}, uvcls::TimerHandle::Time{0});
+    loop->run<uvcls::UVRunMode::SPIN>();
+
+    ASSERT_NE(fired, 0u);
+    ASSERT_LT(fired - begin, 1000000000u);
+}
+
+// 单 socket 的机器上也会执行绑核和 first-touch 的路径
+TEST(Loop, Placement) {
+    cpu_set_t allowed;
+    unsigned int target = 0;
+
+    // 进程可能被限制在部分核上，选第 1 个允许的核
+    ASSERT_EQ(::sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+
+    while (!CPU_ISSET(target, &allowed)) {
+        ++target;
+    }
+
+    auto loop = uvcls::Loop::create({target});
+    uvcls::Placement placement{};
+    uvcls::BufferPool::Buffer held{};
+
+    std::thread thread{[&loop, &placement, &held]() {
+        loop->run();
+        placement = loop->placement();
+
+        auto &pool = loop->buffers();
+        auto data = pool.allocate(1024);
+        ASSERT_TRUE(pool.owns(data.get()));
+        ASSERT_EQ(pool.capacity(), uvcls::BufferPool::CHUNK_BLOCKS);
+
+        // 超过块大小时退化为 new char[]
+        auto large = pool.allocate(pool.blockSize() + 1);
+        ASSERT_FALSE(pool.owns(large.get()));
+
+        // 块可以比 loop 活得更久，最后归还时才释放 chunk
+        held = std::move(data);
+    }};
+
+    thread.join();
+    loop = nullptr;
+    held[0] = 'x';
+    held.reset();
+
+    ASSERT_EQ(placement.cpus, std::vector<unsigned int>{target});
+    ASSERT_EQ(placement.cpu, static_cast<int>(target));
+    ASSERT_GE(placement.node, 0);
+}
+
+TEST(BufferPool, Reuse) {
+    uvcls::BufferPool pool{};
+    auto first = pool.acquire();
+    pool.release(first);
+    ASSERT_EQ(pool.acquire(), first);
+
+    // 其他线程归还的块在空闲链表用完之后取回
+    std::thread thread{[&pool, first]() { pool.release(first); }};
+    thread.join();
+
+    for (std::size_t i = 1; i < uvcls::BufferPool::CHUNK_BLOCKS; ++i) {
+        ASSERT_NE(pool.acquire(), first);
+    }
+
+    ASSERT_EQ(pool.acquire(), first);
+    ASSERT_EQ(pool.capacity(), uvcls::BufferPool::CHUNK_BLOCKS);
+}
+
+// 在其他线程创建的池，bind 之后所有者归还的块直接放回空闲链表
+TEST(BufferPool, Bind) {
+    uvcls::BufferPool pool{};
+
+    std::thread thread{[&pool]() {
+        pool.bind();
+        auto first = pool.acquire();
+        pool.release(first);
+        ASSERT_EQ(pool.acquire(), first);
+        pool.release(first);
+    }};
+
+    thread.join();
+
+    // 可以转换成 std::unique_ptr<char[]>，池中的块复制 1 份后立即归还
+    auto buffer = pool.allocate(4);
+    std::memcpy(buffer.get(), "ping", 4);
+    auto block = buffer.get();
+    std::unique_ptr<char[]> copy = std::move(buffer);
+    ASSERT_FALSE(buffer);
+    ASSERT_NE(copy.get(), block);
+    ASSERT_EQ(std::memcmp(copy.get(), "ping", 4), 0);
+
+    auto large = pool.allocate(pool.blockSize() + 1);
+    auto data = large.get();
+    std::unique_ptr<char[]> moved = std::move(large);
+    ASSERT_EQ(moved.get(), data);
+}
+
+// 阻塞在 poll 上的轮次才算唤醒
+TEST(Loop, Metrics) {
+    auto loop = uvcls::Loop::create();
+    auto idle = loop->resource<uvcls::IdleHandle>();
+    int count = 0;
+
+    idle->on<uvcls::IdleEvent>([&count](const auto &, auto &hndl) {
+        if (++count == 10) {
+            hndl.close();
+        }
+    });
+
+    idle->start();
+    loop->run();
+
+    auto idleMetrics = loop->metrics(true);
+    ASSERT_GE(idleMetrics.iterations, 10u);
+    ASSERT_EQ(idleMetrics.wakeups, 0u);
+
+    uv_timer_t timer;
+    uv_timer_init(loop->raw(), &timer);
+    uv_timer_start(&timer, [](uv_timer_t *handle) { uv_close(reinterpret_cast<uv_handle_t *>(handle), nullptr); }, 5, 0);
+    loop->run();
+
+    auto timerMetrics = loop->metrics();
+    ASSERT_GE(timerMetrics.wakeups, 1u);
+    ASSERT_GT(timerMetrics.rate(), 0);
+}
+
+// 同 1 个阶段中 hrnow 只读 1 次时钟
+TEST(Loop, Now) {
+    auto loop = uvcls::Loop::create();
+    auto idle = loop->resource<uvcls::IdleHandle>();
+    std::vector<uvcls::Loop::HRTime> stamps;
+
+    idle->on<uvcls::IdleEvent>([&stamps](const auto &, auto &hndl) {
+        auto &ref = hndl.loop();
+        auto first = ref.hrnow();
+        ASSERT_EQ(ref.hrnow(), first);
+        ASSERT_EQ(ref.now().count(), uv_now(ref.raw()));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds{2});
+        ASSERT_EQ(ref.hrnow(), first);
+
+        auto before = ref.now();
+        ref.updateTime();
+        ASSERT_GT(ref.hrnow(), first);
+        ASSERT_GE(ref.now() - before, uvcls::Loop::Time{2});
+
+        stamps.push_back(first);
+
+        if (stamps.size() == 3) {
+            hndl.close();
+        }
+    });
+
+    idle->start();
+    loop->run();
+
+    ASSERT_EQ(stamps.size(), 3u);
+    ASSERT_LT(stamps[0], stamps[1]);
+    ASSERT_LT(stamps[1], stamps[2]);
+}
+
+// defer 的任务在同 1 轮中、阻塞之前执行
+TEST(Loop, Defer) {
+    auto loop = uvcls::Loop::create();
+    std::vector<int> order;
+    std::uint64_t iteration = 0;
+
+    // 没有其他 handle 时 defer 也会让 loop 执行 1 轮
+    loop->defer([&order]() { order.push_back(0); });
+    loop->run();
+    ASSERT_EQ(order, (std::vector<int>{0}));
+
+    // 定时器要晚于 idle 所在的那 1 轮到期，1 ms 在慢的机器上可能第 1 轮就已经到期
+    uv_timer_t timer;
+    timer.data = &order;
+    uv_timer_init(loop->raw(), &timer);
+    uv_timer_start(&timer, [](uv_timer_t *handle) {
+        auto &ref = *static_cast<std::vector<int> *>(handle->data);
+        ref.push_back(1);
+        uv_close(reinterpret_cast<uv_handle_t *>(handle), nullptr);
+    }, 50, 0);
+
+    auto idle = loop->resource<uvcls::IdleHandle>();
+    idle->on<uvcls::IdleEvent>([&](const auto &, auto &hndl) {
+        iteration = hndl.loop().metrics().iterations;
+        hndl.loop().defer([&]() {
+            order.push_back(2);
+            // 在 defer 的任务中再 defer
+            hndl.loop().defer([&]() {
+                order.push_back(3);
+                ASSERT_EQ(hndl.loop().metrics().iterations, iteration);
+            });
+        });
+        hndl.close();
+    });
+    idle->start();
+    loop->run();
+
+    ASSERT_EQ(order, (std::vector<int>{0, 2, 3, 1}));
+}
+
+// 长任务分成多段执行，高优先级先执行
+TEST(Loop, Spawn) {
+    auto loop = uvcls::Loop::create();
+    std::vector<int> order;
+    int units = 0;
+    int slices = 0;
+
+    loop->scheduler().slice(std::chrono::microseconds{200});
+
+    loop->spawn([&](const uvcls::TimeSlice &slice) {
+        slices++;
+
+        while (units < 2000 && !slice.expired()) {
+            ++units;
+            std::this_thread::sleep_for(std::chrono::microseconds{1});
+        }
+
+        if (units < 2000) {
+            return true;
+        }
+
+        order.push_back(2);
+        return false;
+    }, uvcls::Priority::BACKGROUND);
+
+    loop->spawn([&order](const uvcls::TimeSlice &) {
+        order.push_back(1);
+        return false;
+    }, uvcls::Priority::HIGH);
+
+    ASSERT_EQ(loop->scheduler().size(), 2u);
+    loop->run();
+
+    ASSERT_EQ(units, 2000);
+    ASSERT_GT(slices, 1);
+    ASSERT_EQ(order, (std::vector<int>{1, 2}));
+    ASSERT_EQ(loop->scheduler().size(), 0u);
+}
+
+// 回调阻塞 loop 时看门狗发布调用栈和正在处理的事件，空闲时不发布
+TEST(Loop, Watchdog) {
+    auto loop = uvcls::Loop::create();
+    auto idle = loop->resource<uvcls::IdleHandle>();
+    std::mutex mutex;
+    std::vector<uvcls::StallEvent> stalls;
+    static std::atomic<int> urgent{0};
+
+    // 应用原来的 SIGURG 处理函数，看门狗运行期间其他来源的信号仍然交给它
+    struct sigaction action {};
+    struct sigaction saved {};
+    action.sa_handler = [](int) { urgent++; };
+    sigemptyset(&action.sa_mask);
+    ASSERT_EQ(::sigaction(SIGURG, &action, &saved), 0);
+
+    loop->watchdog().on<uvcls::StallEvent>([&](auto &event, auto &) {
+        std::lock_guard<std::mutex> lock{mutex};
+        stalls.push_back(std::move(event));
+    });
+    loop->watchdog().start(std::chrono::milliseconds{40});
+    ::raise(SIGURG);
+    ASSERT_EQ(urgent, 1);
+
+    // 空闲地阻塞在 epoll 中
+    uv_timer_t timer;
+    uv_timer_init(loop->raw(), &timer);
+    uv_timer_start(&timer, [](uv_timer_t *handle) { uv_close(reinterpret_cast<uv_handle_t *>(handle), nullptr); }, 150, 0);
+    loop->run();
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        ASSERT_TRUE(stalls.empty());
+    }
+
+    idle->on<uvcls::IdleEvent>([](const auto &, auto &hndl) {
+        for (auto end = uv_hrtime() + 200000000; uv_hrtime() < end;) {
+        }
+
+        hndl.close();
+    });
+    idle->start();
+
+    // 换到另一个线程运行，信号要发给新的 loop 线程
+    std::thread thread{[&loop]() { loop->run(); }};
+    thread.join();
+    loop->watchdog().stop();
+
+    ASSERT_EQ(stalls.size(), 1u);
+    ASSERT_GE(stalls[0].duration, std::chrono::milliseconds{40});
+    ASSERT_FALSE(stalls[0].frames.empty());
+    ASSERT_EQ(stalls[0].event, "uvcls::IdleEvent");
+
+    // 看门狗自己的采样信号不会交给原来的处理函数，stop 之后恢复
+    ASSERT_EQ(urgent, 1);
+    struct sigaction current {};
+    ::sigaction(SIGURG, &saved, &current);
+    ASSERT_EQ(current.sa_handler, action.sa_handler);
+}
+
+// 按时间预算运行，handle 还在时返回 false
+TEST(Loop, RunFor) {
+    auto loop = uvcls::Loop::create();
+    uv_timer_t timer;
+    int ticks = 0;
+
+    timer.data = &ticks;
+    uv_timer_init(loop->raw(), &timer);
+    uv_timer_start(&timer, [](uv_timer_t *handle) { ++*static_cast<int *>(handle->data); }, 5, 5);
+
+    auto begin = uv_hrtime();
+    ASSERT_FALSE(loop->runFor(std::chrono::milliseconds{50}));
+    auto elapsed = uv_hrtime() - begin;
+
+    ASSERT_GE(elapsed, 50000000u);
+    ASSERT_LT(elapsed, 500000000u);
+    ASSERT_GT(ticks, 0);
+    ASSERT_TRUE(loop->alive());
+
+    uv_close(reinterpret_cast<uv_handle_t *>(&timer), nullptr);
+    ASSERT_TRUE(loop->runFor(std::chrono::seconds{10}));
+    ASSERT_FALSE(loop->alive());
+}
+
+// 宿主自己 poll loop 的 fd
+TEST(Loop, Embed) {
+    auto loop = uvcls::Loop::create();
+    uv_timer_t timer;
+    bool fired = false;
+
+    timer.data = &fired;
+    uv_timer_init(loop->raw(), &timer);
+    uv_timer_start(&timer, [](uv_timer_t *handle) {
+        *static_cast<bool *>(handle->data) = true;
+        uv_close(reinterpret_cast<uv_handle_t *>(handle), nullptr);
+    }, 20, 0);
+
+    ASSERT_GE(loop->descriptor(), 0);
+    ASSERT_GT(loop->timeout(), 0);
+
+    while (loop->alive()) {
+        pollfd pfd{loop->descriptor(), POLLIN, 0};
+        ::poll(&pfd, 1, loop->timeout());
+        loop->run<uvcls::UVRunMode::NOWAIT>();
+    }
+
+    ASSERT_TRUE(fired);
+}
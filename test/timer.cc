@@ -0,0 +1,141 @@
+#include <type_traits>
+#include <iostream>
+#include <vector>
+#include "gtest/gtest.h"
+#include "timer.hpp"
+
+TEST(Timer, StartAndStop) {
+    auto loop = uvcls::Loop::getDefault();
+    auto timer = loop->resource<uvcls::TimerHandle>();
+    int count = 0;
+
+    timer->on<uvcls::TimerEvent>([&count](const auto &, auto &hndl) {
+        if (++count == 3) {
+            hndl.stop();
+            hndl.close();
+        }
+    });
+
+    timer->start(uvcls::TimerHandle::Time{1}, uvcls::TimerHandle::Time{1});
+    ASSERT_EQ(timer->repeat(), uvcls::TimerHandle::Time{1});
+    loop->run();
+
+    ASSERT_EQ(count, 3);
+}
+
+// 不同层上的定时器按到期时间执行
+TEST(TimerWheel, Order) {
+    auto loop = uvcls::Loop::getDefault();
+    auto &wheel = loop->wheel();
+    std::vector<int> fired;
+    uvcls::WheelTimer first{[&fired]() { fired.push_back(1); }};
+    uvcls::WheelTimer second{[&fired]() { fired.push_back(2); }};
+    uvcls::WheelTimer third{[&fired]() { fired.push_back(3); }};
+    uvcls::WheelTimer cancelled{[&fired]() { fired.push_back(4); }};
+
+    auto begin = uv_now(loop->raw());
+    wheel.schedule(third, 150);
+    wheel.schedule(second, 70);
+    wheel.schedule(first, 5);
+    wheel.schedule(cancelled, 10);
+    ASSERT_EQ(wheel.size(), 4u);
+
+    wheel.cancel(cancelled);
+    ASSERT_FALSE(cancelled.pending());
+    ASSERT_EQ(wheel.size(), 3u);
+
+    loop->run();
+
+    ASSERT_EQ(fired, (std::vector<int>{1, 2, 3}));
+    ASSERT_GE(uv_now(loop->raw()) - begin, 150u);
+    ASSERT_EQ(wheel.size(), 0u);
+}
+
+// 每次读写时重置的超时：到期之前不断重新调度，只执行 1 次
+TEST(TimerWheel, Reschedule) {
+    auto loop = uvcls::Loop::getDefault();
+    auto &wheel = loop->wheel();
+    auto ticker = loop->resource<uvcls::TimerHandle>();
+    int resets = 0;
+    int fired = 0;
+    uvcls::WheelTimer deadline{[&fired]() { ++fired; }};
+
+    wheel.schedule(deadline, 20);
+
+    ticker->on<uvcls::TimerEvent>([&](const auto &, auto &hndl) {
+        wheel.schedule(deadline, 20);
+
+        if (++resets == 10) {
+            hndl.close();
+        }
+    });
+    ticker->start(uvcls::TimerHandle::Time{2}, uvcls::TimerHandle::Time{2});
+    loop->run();
+
+    ASSERT_EQ(resets, 10);
+    ASSERT_EQ(fired, 1);
+}
+
+TEST(TimerWheel, Destroy) {
+    auto loop = uvcls::Loop::getDefault();
+    auto &wheel = loop->wheel();
+
+    {
+        uvcls::WheelTimer timer{};
+        wheel.schedule(timer, 1000);
+        ASSERT_TRUE(timer.pending());
+    }
+
+    // 析构时自动从时间轮上移除
+    ASSERT_EQ(wheel.size(), 0u);
+    loop->run();
+}
+
+// 对齐到同 1 个时刻的定时器在同 1 轮执行
+TEST(Timer, Slack) {
+    auto loop = uvcls::Loop::getDefault();
+    auto now = uv_now(loop->raw());
+    std::vector<std::uint64_t> deadlines;
+    std::vector<std::uint64_t> iterations;
+
+    for (auto timeout : {3, 9, 12}) {
+        auto timer = loop->resource<uvcls::TimerHandle>();
+        timer->slack(uvcls::TimerHandle::Time{16});
+        timer->on<uvcls::TimerEvent>([&iterations, &loop](const auto &, auto &hndl) {
+            iterations.push_back(loop->metrics().iterations);
+            hndl.close();
+        });
+        timer->start(uvcls::TimerHandle::Time{timeout}, uvcls::TimerHandle::Time{0});
+        deadlines.push_back(uvcls::internal::coalesce(now + timeout, 16));
+    }
+
+    loop->metrics(true);
+    loop->run();
+
+    ASSERT_EQ(iterations.size(), 3u);
+
+    for (std::size_t i = 1; i < deadlines.size(); ++i) {
+        ASSERT_EQ(deadlines[i - 1] == deadlines[i], iterations[i - 1] == iterations[i]);
+    }
+
+    ASSERT_LE(loop->metrics().wakeups, 3u);
+}
+
+TEST(TimerWheel, Slack) {
+    ASSERT_EQ(uvcls::internal::coalesce(3, 0), 3u);
+    ASSERT_EQ(uvcls::internal::coalesce(3, 16), 16u);
+    ASSERT_EQ(uvcls::internal::coalesce(9, 16), 16u);
+    ASSERT_EQ(uvcls::internal::coalesce(100, 10), 104u);
+
+    auto loop = uvcls::Loop::getDefault();
+    auto &wheel = loop->wheel();
+    uvcls::WheelTimer timer{};
+    timer.slack(32);
+
+    auto now = uv_now(loop->raw());
+    wheel.schedule(timer, 5);
+    ASSERT_EQ(timer.deadline(), uvcls::internal::coalesce(now + 5, 32));
+
+    wheel.cancel(timer);
+    loop->run();
+}